@@ -1,3 +1,4 @@
+#include <limits.h>
 #include <stdlib.h>
 #include <time.h>
 #include "arena.h"
@@ -5,97 +6,136 @@
 
 extern const int TILE_SIZE;
 
+/* splitmix64; thread-local so parallel runs each draw their own sequence */
+static _Thread_local uint64_t randomState;
+
+void seedRandom(unsigned int seed) {
+    randomState = seed;
+}
+
+uint64_t saveRandomState(void) {
+    return randomState;
+}
+
+void restoreRandomState(uint64_t state) {
+    randomState = state;
+}
+
+int randomBelow(int bound) {
+    uint64_t z = (randomState += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return (int)(((z ^ (z >> 31)) >> 32) * (uint64_t)bound >> 32);
+}
+
 int randomArenaSize(void) {
     int minSize = MAX_ARENA_SIZE * 3 / 5;
     int range = MAX_ARENA_SIZE - minSize;
-    return rand() % range + minSize;
+    return randomBelow(range) + minSize;
 }
 
-void initArena(Arena *arena) {
-    arena->width = randomArenaSize();
-    arena->height = randomArenaSize();
+int initArena(Arena *arena, int width, int height) {
+    arena->width = width;
+    arena->height = height;
     arena->marker_count = 0;
+    arena->passable_version = 0;
+    arena->words_per_row = (width + 63) / 64;
+    size_t words = (size_t)arena->words_per_row * height;
+    arena->passable = calloc(2 * words, sizeof(uint64_t));
+    if (arena->passable == NULL) return 0;
+    arena->markers = arena->passable + words;
 
-    for (int y = 0; y < arena->height; y++) {
-        for (int x = 0; x < arena->width; x++) {
-            if (x == 0 || x == arena->width-1 || y == 0 || y == arena->height-1) {
-                arena->grid[y][x] = WALL;
-            } else {
-                arena->grid[y][x] = EMPTY;
-            }
-        }
+    for (int y = 1; y < height - 1; y++) {
+        setPassableSpan(arena, y, 1, width - 2, 1);
     }
+    return 1;
 }
 
-int countMarkers(Arena *arena) {
-    return arena->marker_count;
+void freeArena(Arena *arena) {
+    free(arena->passable);
+    arena->passable = NULL;
+    arena->markers = NULL;
 }
 
-void initRobot(Robot *robot, Arena *arena) {
-    do {
-        robot->x = rand() % (arena->width - 4) + 2;
-        robot->y = rand() % (arena->height - 4) + 2;
-    } while (arena->grid[robot->y][robot->x] != EMPTY);
-
-    char directions[] = {'N', 'S', 'E', 'W'};
-    robot->direction = directions[rand() % 4];
-    robot->markers_held = 0;
+static uint64_t spanMask(int fromBit, int count) {
+    uint64_t bits = count == 64 ? ~(uint64_t)0 : ((uint64_t)1 << count) - 1;
+    return bits << fromBit;
 }
 
-static void drawGrid(Arena *arena) {
-    setColour(lightgray);
-    for (int y = 1; y < arena->height-1; y++) {
-        for (int x = 1; x < arena->width-1; x++) {
-            drawRect(x*TILE_SIZE, y*TILE_SIZE, TILE_SIZE, TILE_SIZE);
-        }
+/* Sets tiles fromX..toX of one row a whole word at a time */
+void setPassableSpan(Arena *arena, int y, int fromX, int toX, int passable) {
+    int x = fromX;
+    arena->passable_version++;
+    while (x <= toX) {
+        int count = 64 - (x & 63);
+        if (count > toX - x + 1) count = toX - x + 1;
+        setTileBit(arena->passable, tileWord(arena, x, y), spanMask(x & 63, count), passable);
+        x += count;
     }
 }
 
-static void drawWalls(Arena *arena) {
-    setColour(red);
-    for (int y = 0; y < arena->height; y++) {
-        for (int x = 0; x < arena->width; x++) {
-            if (arena->grid[y][x] == WALL) {
-                fillRect(x*TILE_SIZE, y*TILE_SIZE, TILE_SIZE, TILE_SIZE);
-            }
-        }
-    }
+/* Portable count-trailing-zeros via a de Bruijn sequence; word must be non-zero */
+int lowestSetBit(uint64_t word) {
+    static const int positions[64] = {
+        0, 1, 48, 2, 57, 49, 28, 3, 61, 58, 50, 42, 38, 29, 17, 4,
+        62, 55, 59, 36, 53, 51, 43, 22, 45, 39, 33, 30, 24, 18, 12, 5,
+        63, 47, 56, 27, 60, 41, 37, 16, 54, 35, 52, 21, 44, 32, 23, 11,
+        46, 26, 40, 15, 34, 20, 31, 10, 25, 14, 19, 9, 13, 8, 7, 6
+    };
+    uint64_t isolated = word & (~word + 1);
+    return positions[(isolated * 0x03f79d71b4cb0a89ULL) >> 58];
 }
 
-static void drawObstacles(Arena *arena) {
-    setColour(black);
-    for (int y = 0; y < arena->height; y++) {
-        for (int x = 0; x < arena->width; x++) {
-            if (arena->grid[y][x] == OBSTACLE) {
-                fillRect(x*TILE_SIZE, y*TILE_SIZE, TILE_SIZE, TILE_SIZE);
+int countMarkers(Arena *arena) {
+    return __atomic_load_n(&arena->marker_count, __ATOMIC_ACQUIRE);
+}
+
+/* First empty tile in row order, else the first passable (marker) tile */
+static void scanStartTile(Robot *robot, Arena *arena) {
+    for (int pass = 0; pass < 2; pass++) {
+        for (int tile = 0; tile < arena->width * arena->height; tile++) {
+            int x = tile % arena->width, y = tile / arena->width;
+            if (pass == 0 ? getTile(arena, x, y) == EMPTY : isPassable(arena, x, y)) {
+                robot->x = x;
+                robot->y = y;
+                return;
             }
         }
     }
 }
 
-static void drawMarkers(Arena *arena) {
-    setColour(gray);
+/* Tiny arenas can have markers on every tile the draws reach, so the
+   search falls back to a scan instead of drawing forever */
+void initRobot(Robot *robot, Arena *arena) {
+    int attempts = 0;
+    do {
+        robot->x = randomBelow(arena->width - 4) + 2;
+        robot->y = randomBelow(arena->height - 4) + 2;
+    } while (getTile(arena, robot->x, robot->y) != EMPTY && ++attempts < 1000);
+    if (attempts == 1000) scanStartTile(robot, arena);
+
+    char directions[] = {'N', 'S', 'E', 'W'};
+    robot->direction = directions[randomBelow(4)];
+    robot->markers_held = 0;
+}
+
+static void drawMarker(int x, int y) {
     int markerSize = TILE_SIZE - 10;
     int offset = 5;
+    fillOval(x*TILE_SIZE + offset, y*TILE_SIZE + offset, markerSize, markerSize);
+}
+
+void drawMarkers(Arena *arena) {
+    setColour(gray);
     for (int y = 0; y < arena->height; y++) {
         for (int x = 0; x < arena->width; x++) {
-            if (arena->grid[y][x] == MARKER) {
-                fillOval(x*TILE_SIZE + offset, y*TILE_SIZE + offset,
-                         markerSize, markerSize);
+            if (getTile(arena, x, y) == MARKER) {
+                drawMarker(x, y);
             }
         }
     }
 }
 
-void drawBackground(Arena *arena) {
-    background();
-    clear();
-    drawGrid(arena);
-    drawWalls(arena);
-    drawObstacles(arena);
-    drawMarkers(arena);
-}
-
 static void setNorthTriangle(int cx, int cy, int t, int b,
                               int x[3], int y[3]) {
     x[0] = cx; y[0] = cy - t;
@@ -133,8 +173,7 @@ static void setTrianglePoints(char direction, int cx, int cy, int sz,
     else setWestTriangle(cx, cy, tip, base, xPts, yPts);
 }
 
-void drawRobot(Robot *robot) {
-    clear();
+static void drawRobotShape(Robot *robot) {
     int centerX = robot->x * TILE_SIZE + TILE_SIZE / 2;
     int centerY = robot->y * TILE_SIZE + TILE_SIZE / 2;
     int xPoints[3], yPoints[3];
@@ -145,133 +184,283 @@ void drawRobot(Robot *robot) {
     fillPolygon(3, xPoints, yPoints);
 }
 
+void drawRobot(Robot *robot) {
+    drawRobots(robot, 1);
+}
+
+/* The foreground holds only robots, so it is cleared once per frame */
+void drawRobots(Robot *robots, int count) {
+    clear();
+    for (int i = 0; i < count; i++) drawRobotShape(&robots[i]);
+}
+
 static void calculateShapeParams(Arena *arena, int *cx, int *cy, int *radius) {
     *cx = arena->width / 2;
     *cy = arena->height / 2;
     *radius = (arena->width < arena->height ? arena->width : arena->height) / 3;
 }
 
-static int isInsideShape(int x, int y, int cx, int cy, int radius, ShapeType shape) {
-    int dx = x - cx, dy = y - cy;
-
-    if (shape == SHAPE_CIRCLE) {
-        return (dx*dx + dy*dy) <= (radius * radius);
-    }
-    if (shape == SHAPE_DIAMOND) {
-        int mdist = (x > cx ? x - cx : cx - x) + (y > cy ? y - cy : cy - y);
-        return mdist <= radius;
-    }
-    if (shape == SHAPE_RECTANGLE) {
-        return (dx >= -radius && dx <= radius && dy >= -radius && dy <= radius);
-    }
-    if (shape == SHAPE_OVAL) {
-        int radiusX = radius;
-        int radiusY = radius * 2 / 3;
-        return (dx*dx * radiusY*radiusY + dy*dy * radiusX*radiusX) <= (radiusX*radiusX * radiusY*radiusY);
+/* Tiles cx - half .. cx + half of a row are inside; half < 0 is an empty row */
+typedef int (*RowHalfWidth)(int dy, int radius);
+
+/* Largest n with n * n <= value, for value >= 0: integer Newton iteration
+   down from the power of two at or above the root */
+static long long floorSqrt(long long value) {
+    long long root = 1;
+    if (value < 2) return value;
+    while (root * root < value) root <<= 1;
+    long long next = (root + value / root) / 2;
+    while (next < root) {
+        root = next;
+        next = (root + value / root) / 2;
     }
-    if (shape == SHAPE_TRIANGLE) {
-        if (dy > radius) return 0;
-        int maxWidth = radius + dy;
-        return (dx >= -maxWidth && dx <= maxWidth);
-    }
-    return 0;
+    return root;
 }
 
-void placeShapedObstacles(Arena *arena, ShapeType shape) {
-    int cx, cy, radius;
-    calculateShapeParams(arena, &cx, &cy, &radius);
+static int clampHalf(long long half) {
+    return half > INT_MAX ? INT_MAX : (int)half;
+}
 
-    for (int y = 1; y < arena->height - 1; y++) {
-        for (int x = 1; x < arena->width - 1; x++) {
-            if (!isInsideShape(x, y, cx, cy, radius, shape)) {
-                arena->grid[y][x] = OBSTACLE;
-            }
-        }
-    }
+static int circleHalfWidth(int dy, int radius) {
+    long long room = (long long)radius * radius - (long long)dy * dy;
+    return room < 0 ? -1 : (int)floorSqrt(room);
+}
+
+static int diamondHalfWidth(int dy, int radius) {
+    return radius - abs(dy);
+}
+
+static int rectangleHalfWidth(int dy, int radius) {
+    return abs(dy) <= radius ? radius : -1;
 }
 
-void placeMarkersInShape(Arena *arena, int count, ShapeType shape) {
-    int cx, cy, radius;
+/* dx^2 ry^2 + dy^2 rx^2 <= rx^2 ry^2 solved for dx; a flat oval is one row */
+static int ovalHalfWidth(int dy, int radius) {
+    long long rx = radius, ry = radius * 2 / 3;
+    long long room = rx * rx * (ry * ry - (long long)dy * dy);
+    if (room < 0) return -1;
+    return ry == 0 ? INT_MAX : clampHalf(floorSqrt(room / (ry * ry)));
+}
+
+static int triangleHalfWidth(int dy, int radius) {
+    return dy > radius ? -1 : radius + dy;
+}
+
+static const RowHalfWidth ROW_HALF_WIDTH[SHAPE_COUNT] = {
+    circleHalfWidth, diamondHalfWidth, rectangleHalfWidth, ovalHalfWidth, triangleHalfWidth
+};
+
+/* Inside tiles of row y clipped to the interior; from > to for an empty row */
+static void shapeRowSpan(Arena *arena, ShapeType shape, int y, int *from, int *to) {
+    int cx, cy, radius, right = arena->width - 2;
     calculateShapeParams(arena, &cx, &cy, &radius);
+    int half = ROW_HALF_WIDTH[shape](y - cy, radius);
+    *from = half < 0 ? right + 1 : (half >= cx ? 1 : cx - half);
+    *to = half < 0 ? right : (half > right - cx ? right : cx + half);
+}
 
-    for (int i = 0; i < count; i++) {
-        int x, y, attempts = 0;
-        do {
-            x = rand() % (arena->width - 2) + 1;
-            y = rand() % (arena->height - 2) + 1;
-        } while ((arena->grid[y][x] != EMPTY || !isInsideShape(x, y, cx, cy, radius, shape))
-                 && ++attempts < 100);
-        if (attempts < 100) {
-            arena->grid[y][x] = MARKER;
-            arena->marker_count++;
-        }
+const char *shapeName(ShapeType shape) {
+    static const char *names[SHAPE_COUNT] = {"circle", "diamond", "rectangle", "oval", "triangle"};
+    return names[shape];
+}
+
+void populateArena(Arena *arena, ShapeType shape, int markerCount) {
+    placeShapedObstacles(arena, shape);
+    placeRandomObstacles(arena, arena->width / 6, shape);
+    placeMarkersInShape(arena, markerCount, shape);
+}
+
+/* One half-width per row; the tiles either side of the span are cleared a
+   word at a time. Markers are placed later, so only the passable plane changes */
+void placeShapedObstacles(Arena *arena, ShapeType shape) {
+    int from, to, right = arena->width - 2;
+
+    for (int y = 1; y < arena->height - 1; y++) {
+        shapeRowSpan(arena, shape, y, &from, &to);
+        if (from > 1) setPassableSpan(arena, y, 1, from - 1, 0);
+        if (to < right) setPassableSpan(arena, y, to + 1, right, 0);
     }
 }
 
 static int hasAdjacentObstacles(Arena *arena, int x, int y) {
-    int dx[] = {0, 1, 0, -1};
-    int dy[] = {-1, 0, 1, 0};
     int obstacleCount = 0;
 
     for (int i = 0; i < 4; i++) {
-        int nx = x + dx[i];
-        int ny = y + dy[i];
-        if (arena->grid[ny][nx] == OBSTACLE) {
+        if (getTile(arena, x + DIRECTION_DX[i], y + DIRECTION_DY[i]) == OBSTACLE) {
             obstacleCount++;
         }
     }
     return obstacleCount >= 2;
 }
 
-void placeRandomObstacles(Arena *arena, int count, ShapeType shape) {
-    int cx, cy, radius;
-    calculateShapeParams(arena, &cx, &cy, &radius);
+static int isFreeTile(Arena *arena, int x, int y) {
+    return getTile(arena, x, y) == EMPTY;
+}
 
-    for (int i = 0; i < count; i++) {
-        int x, y, attempts = 0;
-        do {
-            x = rand() % (arena->width - 2) + 1;
-            y = rand() % (arena->height - 2) + 1;
-        } while ((arena->grid[y][x] != EMPTY ||
-                  !isInsideShape(x, y, cx, cy, radius, shape) ||
-                  hasAdjacentObstacles(arena, x, y))
-                 && ++attempts < 200);
-        if (attempts < 200) {
-            arena->grid[y][x] = OBSTACLE;
-        }
+static int isObstacleSite(Arena *arena, int x, int y) {
+    return isFreeTile(arena, x, y) && !hasAdjacentObstacles(arena, x, y);
+}
+
+/* Inside tiles are numbered row by row without being listed: row y's span
+   starts at rowFrom[y] and its first number is rowStart[y]. Draws shuffle
+   that numbering in place, partial Fisher-Yates style, keeping only the
+   moved slots in an open-addressing map (slot + 1 keys, 0 is empty) */
+typedef struct {
+    Arena *arena;
+    int *rowStart;
+    int *rowFrom;
+    int *keys;
+    int *values;
+    int capacity;
+    int used;
+    int remaining;
+} ShapeSampler;
+
+static int initShapeSampler(ShapeSampler *sampler, Arena *arena, ShapeType shape) {
+    int to;
+    *sampler = (ShapeSampler){arena};
+    sampler->rowStart = malloc(2 * (size_t)arena->height * sizeof(int));
+    if (sampler->rowStart == NULL) return 0;
+    sampler->rowFrom = sampler->rowStart + arena->height;
+    for (int y = 0; y < arena->height; y++) {
+        sampler->rowStart[y] = sampler->remaining;
+        sampler->rowFrom[y] = 1;
+        if (y > 0 && y < arena->height - 1) shapeRowSpan(arena, shape, y, &sampler->rowFrom[y], &to);
+        if (y > 0 && y < arena->height - 1) sampler->remaining += to - sampler->rowFrom[y] + 1;
     }
+    return 1;
 }
 
-void initMovementTrail(MovementTrail *trail) {
-    for (int y = 0; y < MAX_ARENA_SIZE; y++) {
-        for (int x = 0; x < MAX_ARENA_SIZE; x++) {
-            trail->horizontal_count[y][x] = 0;
-            trail->vertical_count[y][x] = 0;
-            trail->total_passes[y][x] = 0;
-            for (int i = 0; i < 3; i++) {
-                trail->horizontal_passes[y][x][i] = 0;
-                trail->vertical_passes[y][x][i] = 0;
-            }
-        }
+static void freeShapeSampler(ShapeSampler *sampler) {
+    free(sampler->rowStart);
+    free(sampler->keys);
+}
+
+static int *findSlot(ShapeSampler *sampler, int slot) {
+    unsigned int index = (unsigned int)slot * 2654435761u & (sampler->capacity - 1);
+    while (sampler->keys[index] != 0 && sampler->keys[index] != slot + 1) {
+        index = (index + 1) & (sampler->capacity - 1);
+    }
+    return &sampler->keys[index];
+}
+
+/* Doubles the map once it is half full; returns 0 if out of memory */
+static int reserveSlots(ShapeSampler *sampler) {
+    if (2 * (sampler->used + 1) <= sampler->capacity) return 1;
+    ShapeSampler old = *sampler;
+    sampler->capacity = old.capacity ? 2 * old.capacity : 64;
+    sampler->keys = calloc(2 * (size_t)sampler->capacity, sizeof(int));
+    if (sampler->keys == NULL) return 0;
+    sampler->values = sampler->keys + sampler->capacity;
+    for (int i = 0; i < old.capacity; i++) {
+        if (old.keys[i] == 0) continue;
+        int *key = findSlot(sampler, old.keys[i] - 1);
+        *key = old.keys[i];
+        sampler->values[key - sampler->keys] = old.values[i];
+    }
+    free(old.keys);
+    return 1;
+}
+
+static int slotValue(ShapeSampler *sampler, int slot) {
+    int *key = findSlot(sampler, slot);
+    return *key != 0 ? sampler->values[key - sampler->keys] : slot;
+}
+
+static void setSlot(ShapeSampler *sampler, int slot, int value) {
+    int *key = findSlot(sampler, slot);
+    if (*key == 0) sampler->used++;
+    *key = slot + 1;
+    sampler->values[key - sampler->keys] = value;
+}
+
+/* Maps an inside tile number back to its row by binary search */
+static int numberedTile(ShapeSampler *sampler, int number) {
+    int low = 0, high = sampler->arena->height - 1;
+    while (low < high) {
+        int middle = (low + high + 1) / 2;
+        if (sampler->rowStart[middle] <= number) low = middle;
+        else high = middle - 1;
+    }
+    return low * sampler->arena->width + sampler->rowFrom[low] + number - sampler->rowStart[low];
+}
+
+/* Removes a uniformly chosen inside tile from the pool; -1 once it is empty */
+static int drawShapeTile(ShapeSampler *sampler) {
+    if (sampler->remaining == 0 || !reserveSlots(sampler)) return -1;
+    int slot = randomBelow(sampler->remaining--);
+    int number = slotValue(sampler, slot);
+    setSlot(sampler, slot, slotValue(sampler, sampler->remaining));
+    return numberedTile(sampler, number);
+}
+
+/* Draws until an eligible tile turns up. Placing items only ever makes
+   tiles ineligible, so a rejected tile can leave the pool for good and
+   each inside tile is looked at once at most */
+static int drawEligibleTile(ShapeSampler *sampler, int (*eligible)(Arena *arena, int x, int y)) {
+    int width = sampler->arena->width, tile;
+    do {
+        tile = drawShapeTile(sampler);
+    } while (tile >= 0 && !eligible(sampler->arena, tile % width, tile / width));
+    return tile;
+}
+
+/* Places up to count tiles of type, drawn without replacement from the
+   eligible tiles inside the shape; returns the number placed */
+static int placeInShape(Arena *arena, int count, ShapeType shape, int type,
+                        int (*eligible)(Arena *arena, int x, int y)) {
+    ShapeSampler sampler;
+    int placed = 0, tile;
+    if (!initShapeSampler(&sampler, arena, shape)) return 0;
+    while (placed < count && (tile = drawEligibleTile(&sampler, eligible)) >= 0) {
+        setTile(arena, tile % arena->width, tile / arena->width, type);
+        placed++;
     }
+    freeShapeSampler(&sampler);
+    return placed;
+}
+
+int placeMarkersInShape(Arena *arena, int count, ShapeType shape) {
+    int placed = placeInShape(arena, count, shape, MARKER, isFreeTile);
+    arena->marker_count += placed;
+    return placed;
+}
+
+/* The two-obstacle-neighbour rule is checked against the obstacles placed
+   so far, when each tile is drawn */
+int placeRandomObstacles(Arena *arena, int count, ShapeType shape) {
+    return placeInShape(arena, count, shape, OBSTACLE, isObstacleSite);
+}
+
+int initMovementTrail(MovementTrail *trail, int width, int height) {
+    trail->width = width;
+    trail->height = height;
+    trail->tiles = calloc((size_t)width * height, sizeof(TrailTile));
+    return trail->tiles != NULL;
+}
+
+void freeMovementTrail(MovementTrail *trail) {
+    free(trail->tiles);
+    trail->tiles = NULL;
+}
+
+static TrailTile *trailTile(MovementTrail *trail, int x, int y) {
+    return &trail->tiles[y * trail->width + x];
 }
 
 void recordMovement(MovementTrail *trail, int x, int y, char direction) {
-    if (trail->total_passes[y][x] < 3) {
-        trail->total_passes[y][x]++;
+    TrailTile *tile = trailTile(trail, x, y);
+    if (tile->total_passes < 3) {
+        tile->total_passes++;
     }
 
     if (direction == 'E' || direction == 'W') {
-        if (trail->horizontal_count[y][x] < 3) {
-            int count = trail->horizontal_count[y][x];
-            trail->horizontal_passes[y][x][count] = trail->total_passes[y][x];
-            trail->horizontal_count[y][x]++;
+        if (tile->horizontal_count < 3) {
+            tile->horizontal_passes[tile->horizontal_count++] = tile->total_passes;
         }
     } else {
-        if (trail->vertical_count[y][x] < 3) {
-            int count = trail->vertical_count[y][x];
-            trail->vertical_passes[y][x][count] = trail->total_passes[y][x];
-            trail->vertical_count[y][x]++;
+        if (tile->vertical_count < 3) {
+            tile->vertical_passes[tile->vertical_count++] = tile->total_passes;
         }
     }
 }
@@ -282,31 +471,28 @@ static void setOrderColor(int order) {
     else setColour(red);
 }
 
+/* One filled band covers the 6 one-pixel lines a trail segment is drawn with */
 static void drawTrailLine(int x, int y, int isHorizontal, int offset) {
     int centerX = x * TILE_SIZE + TILE_SIZE / 2;
     int centerY = y * TILE_SIZE + TILE_SIZE / 2;
     int lineLen = TILE_SIZE / 3;
+    int thickness = 6;
 
     if (isHorizontal) {
-        for (int i = -2; i <= 3; i++) {
-            drawLine(centerX - lineLen, centerY + offset + i,
-                    centerX + lineLen, centerY + offset + i);
-        }
+        fillRect(centerX - lineLen, centerY + offset - 2, 2 * lineLen + 1, thickness);
     } else {
-        for (int i = -2; i <= 3; i++) {
-            drawLine(centerX + offset + i, centerY - lineLen,
-                    centerX + offset + i, centerY + lineLen);
-        }
+        fillRect(centerX + offset - 2, centerY - lineLen, thickness, 2 * lineLen + 1);
     }
 }
 
 static void drawHorizontalTrail(MovementTrail *trail, int x, int y) {
-    int count = trail->horizontal_count[y][x];
+    TrailTile *tile = trailTile(trail, x, y);
+    int count = tile->horizontal_count;
     int spacing = 6;
     int startOffset = -(count - 1) * spacing / 2;
 
     for (int i = 0; i < count; i++) {
-        int order = trail->horizontal_passes[y][x][i];
+        int order = tile->horizontal_passes[i];
         if (order > 0) {
             setOrderColor(order);
             drawTrailLine(x, y, 1, startOffset + i * spacing);
@@ -315,12 +501,13 @@ static void drawHorizontalTrail(MovementTrail *trail, int x, int y) {
 }
 
 static void drawVerticalTrail(MovementTrail *trail, int x, int y) {
-    int count = trail->vertical_count[y][x];
+    TrailTile *tile = trailTile(trail, x, y);
+    int count = tile->vertical_count;
     int spacing = 6;
     int startOffset = -(count - 1) * spacing / 2;
 
     for (int i = 0; i < count; i++) {
-        int order = trail->vertical_passes[y][x][i];
+        int order = tile->vertical_passes[i];
         if (order > 0) {
             setOrderColor(order);
             drawTrailLine(x, y, 0, startOffset + i * spacing);
@@ -328,11 +515,56 @@ static void drawVerticalTrail(MovementTrail *trail, int x, int y) {
     }
 }
 
-void drawMovementTrails(MovementTrail *trail, int width, int height) {
-    for (int y = 1; y < height - 1; y++) {
-        for (int x = 1; x < width - 1; x++) {
+void drawMovementTrails(MovementTrail *trail) {
+    for (int y = 1; y < trail->height - 1; y++) {
+        for (int x = 1; x < trail->width - 1; x++) {
             drawHorizontalTrail(trail, x, y);
             drawVerticalTrail(trail, x, y);
         }
     }
 }
+
+int initDirtyTiles(DirtyTiles *dirty, int width, int height) {
+    dirty->count = 0;
+    dirty->width = width;
+    dirty->tiles = malloc((size_t)width * height * sizeof(int));
+    dirty->marked = calloc((size_t)width * height, 1);
+    return dirty->tiles != NULL && dirty->marked != NULL;
+}
+
+void freeDirtyTiles(DirtyTiles *dirty) {
+    free(dirty->tiles);
+    free(dirty->marked);
+    dirty->tiles = NULL;
+    dirty->marked = NULL;
+}
+
+void markTileDirty(DirtyTiles *dirty, int x, int y) {
+    int index = y * dirty->width + x;
+    if (dirty->marked[index]) return;
+    dirty->marked[index] = 1;
+    dirty->tiles[dirty->count++] = index;
+}
+
+/* Repaints the tile interior only, so the shared grid lines stay intact */
+static void drawTile(Arena *arena, MovementTrail *trail, int x, int y) {
+    setColour(white);
+    fillRect(x*TILE_SIZE + 1, y*TILE_SIZE + 1, TILE_SIZE - 1, TILE_SIZE - 1);
+    if (getTile(arena, x, y) == MARKER) {
+        setColour(gray);
+        drawMarker(x, y);
+    }
+    drawHorizontalTrail(trail, x, y);
+    drawVerticalTrail(trail, x, y);
+}
+
+void drawDirtyTiles(DirtyTiles *dirty, Arena *arena, MovementTrail *trail) {
+    if (dirty->count == 0) return;
+    background();
+    for (int i = 0; i < dirty->count; i++) {
+        int index = dirty->tiles[i];
+        drawTile(arena, trail, index % dirty->width, index / dirty->width);
+        dirty->marked[index] = 0;
+    }
+    dirty->count = 0;
+}
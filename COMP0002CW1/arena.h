@@ -1,9 +1,15 @@
 #ifndef ARENA_H
 #define ARENA_H
 
+#include <stddef.h>
+#include <stdint.h>
 #include "robot.h"
 
 #define MAX_ARENA_SIZE 40
+/* Smallest runtime width or height */
+#define MIN_ARENA_SIZE 8
+/* Largest runtime width or height; keeps width * height within an int */
+#define MAX_ARENA_DIMENSION 32768
 
 #define EMPTY 0
 #define WALL 1
@@ -22,13 +28,62 @@ typedef enum {
     SHAPE_TRIANGLE
 } ShapeType;
 
+#define SHAPE_COUNT 5
+
+/* One bit per tile in two bitplanes sharing a single allocation, each row
+   padded to whole 64-bit words (padding bits stay clear). Walls are exactly
+   the border, so an impassable tile is a WALL there and an OBSTACLE inside.
+   passable_version changes whenever a passable bit may have changed */
 typedef struct {
-    int grid[MAX_ARENA_SIZE][MAX_ARENA_SIZE];
+    uint64_t *passable;
+    uint64_t *markers;
+    int words_per_row;
     int width;
     int height;
     int marker_count;
+    unsigned int passable_version;
 } Arena;
 
+static inline size_t tileWord(const Arena *arena, int x, int y) {
+    return (size_t)y * arena->words_per_row + (x >> 6);
+}
+
+static inline uint64_t tileMask(int x) {
+    return (uint64_t)1 << (x & 63);
+}
+
+static inline int isPassable(const Arena *arena, int x, int y) {
+    return (arena->passable[tileWord(arena, x, y)] & tileMask(x)) != 0;
+}
+
+static inline int hasMarker(const Arena *arena, int x, int y) {
+    return (arena->markers[tileWord(arena, x, y)] & tileMask(x)) != 0;
+}
+
+static inline int isBorder(const Arena *arena, int x, int y) {
+    return x == 0 || y == 0 || x == arena->width - 1 || y == arena->height - 1;
+}
+
+static inline int getTile(const Arena *arena, int x, int y) {
+    if (hasMarker(arena, x, y)) return MARKER;
+    if (isPassable(arena, x, y)) return EMPTY;
+    return isBorder(arena, x, y) ? WALL : OBSTACLE;
+}
+
+static inline void setTileBit(uint64_t *plane, size_t word, uint64_t mask, int value) {
+    if (value) plane[word] |= mask;
+    else plane[word] &= ~mask;
+}
+
+/* Markers are passable, so picking one up or dropping one keeps the version */
+static inline void setTile(Arena *arena, int x, int y, int tile) {
+    size_t word = tileWord(arena, x, y);
+    int passable = tile == EMPTY || tile == MARKER;
+    if (passable != isPassable(arena, x, y)) arena->passable_version++;
+    setTileBit(arena->passable, word, tileMask(x), passable);
+    setTileBit(arena->markers, word, tileMask(x), tile == MARKER);
+}
+
 void forward(Robot *robot, Arena *arena);
 void left(Robot *robot);
 void right(Robot *robot);
@@ -37,32 +92,70 @@ int canMoveForward(Robot *robot, Arena *arena);
 void pickUpMarker(Robot *robot, Arena *arena);
 void dropMarker(Robot *robot, Arena *arena);
 int markerCount(Robot *robot);
+int directionIndex(char direction);
+int turnTowards(Robot *robot, int x, int y);
 
 #define FIRST_PASS 1
 #define SECOND_PASS 2
 #define THIRD_PASS 3
 
 typedef struct {
-    int horizontal_passes[MAX_ARENA_SIZE][MAX_ARENA_SIZE][3];
-    int vertical_passes[MAX_ARENA_SIZE][MAX_ARENA_SIZE][3];
-    int horizontal_count[MAX_ARENA_SIZE][MAX_ARENA_SIZE];
-    int vertical_count[MAX_ARENA_SIZE][MAX_ARENA_SIZE];
-    int total_passes[MAX_ARENA_SIZE][MAX_ARENA_SIZE];
+    unsigned char horizontal_passes[3];
+    unsigned char vertical_passes[3];
+    unsigned char horizontal_count;
+    unsigned char vertical_count;
+    unsigned char total_passes;
+} TrailTile;
+
+typedef struct {
+    TrailTile *tiles;
+    int width;
+    int height;
 } MovementTrail;
 
-void initArena(Arena *arena);
+/* Tiles whose background-layer drawing is out of date; each tile is
+   queued at most once between redraws */
+typedef struct {
+    int *tiles;
+    unsigned char *marked;
+    int count;
+    int width;
+} DirtyTiles;
+
+int initArena(Arena *arena, int width, int height);
+void freeArena(Arena *arena);
+void setPassableSpan(Arena *arena, int y, int fromX, int toX, int passable);
+int lowestSetBit(uint64_t word);
 int countMarkers(Arena *arena);
 void initRobot(Robot *robot, Arena *arena);
-void drawBackground(Arena *arena);
+void drawMarkers(Arena *arena);
 void drawRobot(Robot *robot);
+void drawRobots(Robot *robots, int count);
 int randomArenaSize(void);
+/* Per-thread generator behind every random arena, robot and query */
+void seedRandom(unsigned int seed);
+int randomBelow(int bound);
+/* The generator's position, so a later run can resume the same sequence */
+uint64_t saveRandomState(void);
+void restoreRandomState(uint64_t state);
 
+const char *shapeName(ShapeType shape);
+void populateArena(Arena *arena, ShapeType shape, int markerCount);
 void placeShapedObstacles(Arena *arena, ShapeType shape);
-void placeMarkersInShape(Arena *arena, int count, ShapeType shape);
-void placeRandomObstacles(Arena *arena, int count, ShapeType shape);
+/* Both draw without replacement from the eligible tiles inside the shape,
+   so they place count items unless fewer tiles qualify. They return the
+   number placed */
+int placeMarkersInShape(Arena *arena, int count, ShapeType shape);
+int placeRandomObstacles(Arena *arena, int count, ShapeType shape);
 
-void initMovementTrail(MovementTrail *trail);
+int initMovementTrail(MovementTrail *trail, int width, int height);
+void freeMovementTrail(MovementTrail *trail);
 void recordMovement(MovementTrail *trail, int x, int y, char direction);
-void drawMovementTrails(MovementTrail *trail, int width, int height);
+void drawMovementTrails(MovementTrail *trail);
+
+int initDirtyTiles(DirtyTiles *dirty, int width, int height);
+void freeDirtyTiles(DirtyTiles *dirty);
+void markTileDirty(DirtyTiles *dirty, int x, int y);
+void drawDirtyTiles(DirtyTiles *dirty, Arena *arena, MovementTrail *trail);
 
 #endif
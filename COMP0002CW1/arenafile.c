@@ -0,0 +1,178 @@
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "arenafile.h"
+
+static size_t planeWords(uint64_t width, uint64_t height) {
+    return (size_t)((width + 63) / 64 * height);
+}
+
+/* 64-bit so a corrupt header can't wrap it round to a small size */
+static uint64_t recordSize(uint64_t width, uint64_t height, uint64_t markerCount) {
+    uint64_t size = sizeof(ArenaFileHeader) + planeWords(width, height) * sizeof(uint64_t) +
+                    markerCount * sizeof(uint32_t);
+    return (size + 7) & ~(uint64_t)7;
+}
+
+static int isValidHeader(const ArenaFileHeader *header, size_t available) {
+    return memcmp(header->magic, ARENA_FILE_MAGIC, 4) == 0 &&
+           header->width >= MIN_ARENA_SIZE && header->width <= MAX_ARENA_DIMENSION &&
+           header->height >= MIN_ARENA_SIZE && header->height <= MAX_ARENA_DIMENSION &&
+           header->shape < SHAPE_COUNT &&
+           header->markerCount <= header->width * header->height &&
+           header->size == recordSize(header->width, header->height, header->markerCount) &&
+           header->size <= available;
+}
+
+static void recordAt(const unsigned char *data, ArenaRecord *record) {
+    record->header = (const ArenaFileHeader *)data;
+    record->passable = (const uint64_t *)(data + sizeof(ArenaFileHeader));
+    record->markers = (const uint32_t *)(record->passable +
+                                         planeWords(record->header->width, record->header->height));
+}
+
+static uint32_t countMarkerBits(const Arena *arena) {
+    uint32_t count = 0;
+    size_t words = (size_t)arena->words_per_row * arena->height;
+    for (size_t i = 0; i < words; i++) {
+        for (uint64_t word = arena->markers[i]; word != 0; word &= word - 1) count++;
+    }
+    return count;
+}
+
+/* Marker tiles in row order, read off the marker bitplane */
+static int writeMarkers(FILE *file, const Arena *arena) {
+    int ok = 1;
+    for (int y = 0; y < arena->height; y++) {
+        for (int w = 0; w < arena->words_per_row; w++) {
+            for (uint64_t word = arena->markers[tileWord(arena, w * 64, y)]; word != 0; word &= word - 1) {
+                uint32_t tile = (uint32_t)y * arena->width + w * 64 + lowestSetBit(word);
+                ok &= fwrite(&tile, sizeof tile, 1, file) == 1;
+            }
+        }
+    }
+    return ok;
+}
+
+int writeArena(FILE *file, const Arena *arena, const ArenaInfo *info) {
+    static const unsigned char padding[8] = {0};
+    ArenaFileHeader header = {ARENA_FILE_MAGIC, 0, info->seed, countMarkerBits(arena),
+                              arena->width, arena->height, info->shape, 0, info->randomState};
+    uint64_t size = recordSize(header.width, header.height, header.markerCount);
+    size_t words = planeWords(header.width, header.height);
+    if (size > UINT32_MAX) return 0;
+    header.size = (uint32_t)size;
+    int ok = fwrite(&header, sizeof header, 1, file) == 1 &&
+             fwrite(arena->passable, sizeof(uint64_t), words, file) == words && writeMarkers(file, arena);
+    size_t pad = (size_t)(size - sizeof header - words * sizeof(uint64_t) - header.markerCount * sizeof(uint32_t));
+    return ok && fwrite(padding, 1, pad, file) == pad;
+}
+
+/* Row padding bits must stay clear, whatever the file holds */
+static void clearRowPadding(Arena *arena) {
+    if ((arena->width & 63) == 0) return;
+    uint64_t mask = ((uint64_t)1 << (arena->width & 63)) - 1;
+    for (int y = 0; y < arena->height; y++) {
+        arena->passable[tileWord(arena, arena->width - 1, y)] &= mask;
+    }
+}
+
+/* Searches step to neighbours without bounds checks, relying on this */
+static int hasClosedBorder(const Arena *arena) {
+    for (int w = 0; w < arena->words_per_row; w++) {
+        if (arena->passable[tileWord(arena, w * 64, 0)] != 0 ||
+            arena->passable[tileWord(arena, w * 64, arena->height - 1)] != 0) return 0;
+    }
+    for (int y = 1; y < arena->height - 1; y++) {
+        if (isPassable(arena, 0, y) || isPassable(arena, arena->width - 1, y)) return 0;
+    }
+    return 1;
+}
+
+/* Each marker must be a distinct passable tile */
+static int placeRecordMarkers(const ArenaRecord *record, Arena *arena) {
+    uint32_t tiles = (uint32_t)arena->width * arena->height;
+    for (uint32_t i = 0; i < record->header->markerCount; i++) {
+        uint32_t tile = record->markers[i];
+        int x = tile % arena->width, y = tile / arena->width;
+        if (tile >= tiles || !isPassable(arena, x, y) || hasMarker(arena, x, y)) return 0;
+        setTile(arena, x, y, MARKER);
+    }
+    arena->marker_count = (int)record->header->markerCount;
+    return 1;
+}
+
+int loadCorpusArena(const ArenaRecord *record, Arena *arena) {
+    const ArenaFileHeader *header = record->header;
+    if (!initArena(arena, (int)header->width, (int)header->height)) return 0;
+    memcpy(arena->passable, record->passable, planeWords(header->width, header->height) * sizeof(uint64_t));
+    clearRowPadding(arena);
+    if (hasClosedBorder(arena) && placeRecordMarkers(record, arena)) return 1;
+    freeArena(arena);
+    return 0;
+}
+
+/* The whole record is read into one buffer and loaded like a mapped one */
+int readArena(FILE *file, Arena *arena, ArenaInfo *info) {
+    ArenaFileHeader header;
+    ArenaRecord record;
+    if (fread(&header, sizeof header, 1, file) != 1 || !isValidHeader(&header, UINT32_MAX)) return 0;
+    unsigned char *data = malloc(header.size);
+    int ok = data != NULL && fread(data + sizeof header, header.size - sizeof header, 1, file) == 1;
+    if (ok) {
+        memcpy(data, &header, sizeof header);
+        recordAt(data, &record);
+        ok = loadCorpusArena(&record, arena);
+        *info = (ArenaInfo){header.shape, header.seed, header.randomState};
+    }
+    free(data);
+    return ok;
+}
+
+/* Counts the records, stopping at the first header that is bad or runs
+   past the end of the file */
+static int countRecords(ArenaCorpus *corpus) {
+    size_t offset = 0;
+    corpus->count = 0;
+    while (offset < corpus->size) {
+        const ArenaFileHeader *header = (const ArenaFileHeader *)(corpus->data + offset);
+        if (corpus->size - offset < sizeof *header || !isValidHeader(header, corpus->size - offset)) return 0;
+        offset += header->size;
+        corpus->count++;
+    }
+    return 1;
+}
+
+/* Records are multiples of 8 bytes and the mapping is page aligned, so
+   every header and bitplane in it is aligned too */
+int openArenaCorpus(const char *path, ArenaCorpus *corpus) {
+    struct stat status;
+    void *data = MAP_FAILED;
+    int fd = open(path, O_RDONLY);
+    *corpus = (ArenaCorpus){0};
+    if (fd < 0) return 0;
+    if (fstat(fd, &status) == 0 && status.st_size > 0) {
+        data = mmap(NULL, (size_t)status.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    }
+    close(fd);
+    if (data == MAP_FAILED) return 0;
+    *corpus = (ArenaCorpus){data, (size_t)status.st_size, 0};
+    if (countRecords(corpus)) return 1;
+    closeArenaCorpus(corpus);
+    return 0;
+}
+
+void closeArenaCorpus(ArenaCorpus *corpus) {
+    if (corpus->data != NULL) munmap((void *)corpus->data, corpus->size);
+    *corpus = (ArenaCorpus){0};
+}
+
+int nextCorpusArena(const ArenaCorpus *corpus, size_t *offset, ArenaRecord *record) {
+    if (*offset >= corpus->size) return 0;
+    recordAt(corpus->data + *offset, record);
+    *offset += record->header->size;
+    return 1;
+}
@@ -0,0 +1,66 @@
+#ifndef ARENAFILE_H
+#define ARENAFILE_H
+
+#include <stdio.h>
+#include "arena.h"
+
+#define ARENA_FILE_MAGIC "ARN1"
+
+/* One arena record: this header, the passable bitplane exactly as Arena
+   holds it (words_per_row words per row), then markerCount tile indices
+   (y * width + x), zero-padded to a multiple of 8 bytes. size covers the
+   whole record, so records can be skipped without reading them. Fields
+   are in host byte order. A corpus file is records back to back */
+typedef struct {
+    char magic[4];
+    uint32_t size;
+    uint32_t seed;
+    uint32_t markerCount;
+    uint32_t width;
+    uint32_t height;
+    uint32_t shape;
+    uint32_t reserved;
+    uint64_t randomState;
+} ArenaFileHeader;
+
+/* randomState is the generator position right after the arena was made;
+   resuming from it places robots where the generating run did */
+typedef struct {
+    ShapeType shape;
+    unsigned int seed;
+    uint64_t randomState;
+} ArenaInfo;
+
+/* A record inside a mapped corpus; every pointer points into the mapping */
+typedef struct {
+    const ArenaFileHeader *header;
+    const uint64_t *passable;
+    const uint32_t *markers;
+} ArenaRecord;
+
+/* A read-only memory mapping of a whole corpus file */
+typedef struct {
+    const unsigned char *data;
+    size_t size;
+    int count;
+} ArenaCorpus;
+
+/* Appends one record; returns 0 on a write error or an arena too large
+   for the format */
+int writeArena(FILE *file, const Arena *arena, const ArenaInfo *info);
+/* Reads the next record into a fresh arena. Returns 0 at end of file or
+   on a bad record, leaving nothing to free */
+int readArena(FILE *file, Arena *arena, ArenaInfo *info);
+
+/* Maps path and checks every record header, so the iteration below never
+   reads outside the file. Returns 0 if the file can't be mapped or holds
+   a bad record */
+int openArenaCorpus(const char *path, ArenaCorpus *corpus);
+void closeArenaCorpus(ArenaCorpus *corpus);
+/* Steps *offset (0 for the first record) through the corpus without
+   copying; returns 0 after the last record */
+int nextCorpusArena(const ArenaCorpus *corpus, size_t *offset, ArenaRecord *record);
+/* Copies a record into a fresh arena the simulation may change */
+int loadCorpusArena(const ArenaRecord *record, Arena *arena);
+
+#endif
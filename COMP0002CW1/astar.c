@@ -0,0 +1,167 @@
+#include <stdlib.h>
+#include "pathsearch.h"
+#include "profile.h"
+
+#define UNSEEN 0
+#define OPEN 1
+#define CLOSED 2
+
+static void assignBuffers(AStarSearch *search, PathWorkspace *workspace) {
+    search->stamp = workspace->stamp;
+    search->generation = workspace->generation;
+    search->heapKeys = workspace->heapKeys;
+    search->heapTiles = workspace->queue;
+    search->heapIndex = workspace->heapIndex;
+    search->cost = workspace->cost;
+    search->parent = workspace->parent;
+    search->state = workspace->state;
+}
+
+static int tileState(AStarSearch *search, int tile) {
+    return search->stamp[tile] == search->generation ? search->state[tile] : UNSEEN;
+}
+
+static void setTileState(AStarSearch *search, int tile, unsigned char state) {
+    search->stamp[tile] = search->generation;
+    search->state[tile] = state;
+}
+
+static void expandNeighbours(AStarSearch *search, int tile) {
+    int width = search->arena->width;
+    int x = tile % width, y = tile / width;
+    for (int i = 0; i < 4; i++) {
+        int nx = x + DIRECTION_DX[i], ny = y + DIRECTION_DY[i];
+        if (isPassable(search->arena, nx, ny)) relaxSuccessor(search, tile, ny * width + nx, 1);
+    }
+}
+
+static int manhattanEstimate(AStarSearch *search, int tile) {
+    int dx = tile % search->arena->width - search->endX;
+    int dy = tile / search->arena->width - search->endY;
+    return abs(dx) + abs(dy);
+}
+
+static int reachedEnd(AStarSearch *search, int node) {
+    return node == search->end;
+}
+
+void initAStar(AStarSearch *search, PathWorkspace *workspace, int endX, int endY) {
+    beginSearch(workspace);
+    assignBuffers(search, workspace);
+    search->arena = workspace->arena;
+    search->endX = endX;
+    search->endY = endY;
+    search->end = endY * workspace->arena->width + endX;
+    search->heapSize = 0;
+    search->expanded = 0;
+    search->expand = expandNeighbours;
+    search->estimate = manhattanEstimate;
+    search->reached = reachedEnd;
+}
+
+/* Orders by f = cost + h, then by smaller h so ties expand towards the goal */
+static uint64_t searchKey(int cost, int h) {
+    return ((uint64_t)(cost + h) << 32) | (uint32_t)h;
+}
+
+static int heapLess(AStarSearch *search, int i, int j) {
+    if (search->heapKeys[i] != search->heapKeys[j]) {
+        return search->heapKeys[i] < search->heapKeys[j];
+    }
+    return search->heapTiles[i] < search->heapTiles[j];
+}
+
+static void heapSwap(AStarSearch *search, int i, int j) {
+    uint64_t key = search->heapKeys[i];
+    int tile = search->heapTiles[i];
+    search->heapKeys[i] = search->heapKeys[j];
+    search->heapTiles[i] = search->heapTiles[j];
+    search->heapKeys[j] = key;
+    search->heapTiles[j] = tile;
+    search->heapIndex[search->heapTiles[i]] = i;
+    search->heapIndex[search->heapTiles[j]] = j;
+}
+
+static void siftUp(AStarSearch *search, int slot) {
+    while (slot > 0 && heapLess(search, slot, (slot - 1) / 2)) {
+        heapSwap(search, slot, (slot - 1) / 2);
+        slot = (slot - 1) / 2;
+    }
+}
+
+static void siftDown(AStarSearch *search, int slot) {
+    for (;;) {
+        int smallest = slot, left = 2 * slot + 1, right = 2 * slot + 2;
+        if (left < search->heapSize && heapLess(search, left, smallest)) smallest = left;
+        if (right < search->heapSize && heapLess(search, right, smallest)) smallest = right;
+        if (smallest == slot) return;
+        heapSwap(search, slot, smallest);
+        slot = smallest;
+    }
+}
+
+static void pushOrDecrease(AStarSearch *search, int tile, uint64_t key) {
+    int slot = tileState(search, tile) == OPEN ? search->heapIndex[tile] : search->heapSize++;
+    search->heapTiles[slot] = tile;
+    search->heapKeys[slot] = key;
+    search->heapIndex[tile] = slot;
+    setTileState(search, tile, OPEN);
+    siftUp(search, slot);
+}
+
+static int popMin(AStarSearch *search) {
+    int tile = search->heapTiles[0];
+    search->heapSize--;
+    if (search->heapSize > 0) {
+        heapSwap(search, 0, search->heapSize);
+        siftDown(search, 0);
+    }
+    setTileState(search, tile, CLOSED);
+    return tile;
+}
+
+void relaxSuccessor(AStarSearch *search, int node, int next, int stepCost) {
+    int cost = search->cost[node] + stepCost;
+    int state = tileState(search, next);
+    if (state == CLOSED) return;
+    if (state == OPEN && search->cost[next] <= cost) return;
+    search->cost[next] = cost;
+    search->parent[next] = node;
+    pushOrDecrease(search, next, searchKey(cost, search->estimate(search, next)));
+}
+
+void addSearchStart(AStarSearch *search, int node) {
+    search->cost[node] = 0;
+    search->parent[node] = node;
+    pushOrDecrease(search, node, searchKey(0, search->estimate(search, node)));
+}
+
+int astarSearch(AStarSearch *search) {
+    while (search->heapSize > 0) {
+        PROFILE_PEAK(PROFILE_ASTAR_HEAP, search->heapSize);
+        int node = popMin(search);
+        if (search->reached(search, node)) return node;
+        PROFILE_COUNT(PROFILE_EXPANDED, 1);
+        search->expanded++;
+        search->expand(search, node);
+    }
+    return -1;
+}
+
+/* Manhattan distance is consistent for unit 4-connected moves, so a tile
+   is final once popped and the path is as short as the BFS one */
+int findPathAStar(PathWorkspace *workspace, int startX, int startY,
+                  int endX, int endY, Path *path) {
+    AStarSearch search;
+    Arena *arena = workspace->arena;
+    int found = 0;
+    initAStar(&search, workspace, endX, endY);
+
+    int start = startY * arena->width + startX;
+    addSearchStart(&search, start);
+    if (astarSearch(&search) >= 0) {
+        found = buildPathFromParents(arena, search.parent, start, search.end, path);
+    }
+    path->expanded = search.expanded;
+    return found;
+}
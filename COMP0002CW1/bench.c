@@ -0,0 +1,223 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "bench.h"
+
+/* Slot 0 is the BFS baseline, slot 1 the algorithm under test. targets
+   holds the goals distance field queries reuse; steps sums the lengths of
+   paths both found. setupMs is preparePathSearch's time, kept out of the
+   query times. The flip fields cover hpa's tile change check: refreshMs
+   is the incremental update after each flip, rebuildMs a full build */
+typedef struct {
+    PathWorkspace workspace;
+    int targets[BENCH_FIELD_TARGETS][2];
+    int queries;
+    int mismatches;
+    long expanded[2];
+    long steps[2];
+    double elapsedMs[2];
+    double setupMs;
+    int flips;
+    int flipMismatches;
+    double refreshMs;
+    double rebuildMs;
+} PathBenchmark;
+
+double currentTimeMs(void) {
+    struct timespec now;
+    timespec_get(&now, TIME_UTC);
+    return now.tv_sec * 1000.0 + now.tv_nsec / 1000000.0;
+}
+
+static void randomPassableTile(Arena *arena, int *x, int *y) {
+    do {
+        *x = randomBelow(arena->width);
+        *y = randomBelow(arena->height);
+    } while (!isPassable(arena, *x, *y));
+}
+
+static int timedSearch(PathAlgorithm algorithm, const int query[4],
+                       Path *path, PathBenchmark *bench, int slot) {
+    double start = currentTimeMs();
+    int found = findPathWith(&bench->workspace, algorithm, query[0], query[1],
+                             query[2], query[3], path);
+    bench->elapsedMs[slot] += currentTimeMs() - start;
+    bench->expanded[slot] += path->expanded;
+    return found;
+}
+
+static int isValidPath(Arena *arena, const int query[4], Path *path) {
+    int x = query[0], y = query[1];
+    for (int i = 0; i < path->length; i++) {
+        if (abs(path->x[i] - x) + abs(path->y[i] - y) != 1) return 0;
+        if (!isPassable(arena, path->x[i], path->y[i])) return 0;
+        x = path->x[i];
+        y = path->y[i];
+    }
+    return x == query[2] && y == query[3];
+}
+
+/* Distance field queries end at one of the arena's shared targets */
+static void randomQuery(Arena *arena, PathAlgorithm algorithm, PathBenchmark *bench, int query[4]) {
+    randomPassableTile(arena, &query[0], &query[1]);
+    randomPassableTile(arena, &query[2], &query[3]);
+    if (algorithm == PATH_DISTANCE_FIELD) {
+        int target = randomBelow(BENCH_FIELD_TARGETS);
+        query[2] = bench->targets[target][0];
+        query[3] = bench->targets[target][1];
+    }
+}
+
+static void benchmarkQuery(Arena *arena, PathAlgorithm algorithm, Path paths[2],
+                           PathBenchmark *bench) {
+    int query[4];
+    randomQuery(arena, algorithm, bench, query);
+    int foundByBfs = timedSearch(PATH_BFS, query, &paths[0], bench, 0);
+    int found = timedSearch(algorithm, query, &paths[1], bench, 1);
+    bench->queries++;
+    if (found && foundByBfs) {
+        bench->steps[0] += paths[0].length;
+        bench->steps[1] += paths[1].length;
+    }
+    if (found != foundByBfs || paths[0].length != paths[1].length ||
+        (found && !isValidPath(arena, query, &paths[1]))) {
+        bench->mismatches++;
+    }
+}
+
+/* Any tile inside the border without a marker, so no marker is lost */
+static void flipRandomTile(Arena *arena, int *x, int *y) {
+    do {
+        *x = 1 + randomBelow(arena->width - 2);
+        *y = 1 + randomBelow(arena->height - 2);
+    } while (hasMarker(arena, *x, *y));
+    setTile(arena, *x, *y, isPassable(arena, *x, *y) ? OBSTACLE : EMPTY);
+}
+
+static double timedPrepare(PathWorkspace *workspace) {
+    double start = currentTimeMs();
+    preparePathSearch(workspace, PATH_HIERARCHICAL);
+    return currentTimeMs() - start;
+}
+
+/* One random query on the refreshed graph, the freshly built one and BFS;
+   any difference between them counts as a mismatch */
+static void compareFlipQuery(Arena *arena, PathWorkspace *fresh, Path paths[2], PathBenchmark *bench) {
+    int query[4];
+    randomPassableTile(arena, &query[0], &query[1]);
+    randomPassableTile(arena, &query[2], &query[3]);
+    int found = findPathWith(&bench->workspace, PATH_HIERARCHICAL, query[0], query[1],
+                             query[2], query[3], &paths[1]);
+    int foundFresh = findPathWith(fresh, PATH_HIERARCHICAL, query[0], query[1],
+                                  query[2], query[3], &paths[0]);
+    int freshLength = paths[0].length;
+    int foundByBfs = findPathWith(fresh, PATH_BFS, query[0], query[1], query[2], query[3], &paths[0]);
+    bench->flips++;
+    if (found != foundFresh || found != foundByBfs || paths[1].length != freshLength ||
+        (found && !isValidPath(arena, query, &paths[1]))) {
+        bench->flipMismatches++;
+    }
+}
+
+/* Flips a tile, reports it, and times the refresh against a full build */
+static void benchmarkFlip(Arena *arena, Path paths[2], PathBenchmark *bench) {
+    PathWorkspace fresh;
+    int x, y;
+    flipRandomTile(arena, &x, &y);
+    invalidatePathTile(&bench->workspace, x, y);
+    bench->refreshMs += timedPrepare(&bench->workspace);
+    if (!initPathWorkspace(&fresh, arena)) return;
+    bench->rebuildMs += timedPrepare(&fresh);
+    compareFlipQuery(arena, &fresh, paths, bench);
+    freePathWorkspace(&fresh);
+}
+
+static void benchmarkQueries(Arena *arena, PathAlgorithm algorithm, Path paths[2],
+                             PathBenchmark *bench) {
+    for (int i = 0; algorithm == PATH_DISTANCE_FIELD && i < BENCH_FIELD_TARGETS; i++) {
+        randomPassableTile(arena, &bench->targets[i][0], &bench->targets[i][1]);
+    }
+    for (int i = 0; i < BENCH_QUERIES_PER_ARENA; i++) {
+        benchmarkQuery(arena, algorithm, paths, bench);
+    }
+    for (int i = 0; algorithm == PATH_HIERARCHICAL && i < BENCH_FLIPS_PER_ARENA; i++) {
+        benchmarkFlip(arena, paths, bench);
+    }
+}
+
+static void benchmarkArena(Arena *arena, PathAlgorithm algorithm, PathBenchmark *bench) {
+    Path paths[2] = {{0}, {0}};
+    int tiles = arena->width * arena->height;
+    if (initPath(&paths[0], tiles) && initPath(&paths[1], tiles) &&
+        initPathWorkspace(&bench->workspace, arena)) {
+        double start = currentTimeMs();
+        preparePathSearch(&bench->workspace, algorithm);
+        bench->setupMs += currentTimeMs() - start;
+        benchmarkQueries(arena, algorithm, paths, bench);
+        freePathWorkspace(&bench->workspace);
+    }
+    freePath(&paths[0]);
+    freePath(&paths[1]);
+}
+
+static void benchmarkSeed(unsigned int seed, ShapeType shape, const int size[2],
+                          PathAlgorithm algorithm, PathBenchmark *bench) {
+    Arena arena;
+    seedRandom(seed);
+    int width = size[0] ? size[0] : randomArenaSize();
+    int height = size[1] ? size[1] : randomArenaSize();
+    if (initArena(&arena, width, height)) {
+        populateArena(&arena, shape, 3 + randomBelow(5));
+        benchmarkArena(&arena, algorithm, bench);
+    }
+    freeArena(&arena);
+}
+
+static void printFlipCheck(ShapeType shape, PathBenchmark *bench) {
+    printf("shape=%s flips=%d flip_mismatches=%d refresh_ms=%.3f rebuild_ms=%.3f\n",
+           shapeName(shape), bench->flips, bench->flipMismatches, bench->refreshMs, bench->rebuildMs);
+}
+
+static void printBenchmark(ShapeType shape, PathAlgorithm algorithm, PathBenchmark *bench) {
+    const char *name = pathAlgorithmName(algorithm);
+    printf("shape=%s queries=%d bfs_expanded=%ld %s_expanded=%ld expanded_ratio=%.2f"
+           " bfs_ms=%.3f %s_ms=%.3f speedup=%.2f mismatches=%d extra_steps_pct=%.2f setup_ms=%.3f\n",
+           shapeName(shape), bench->queries, bench->expanded[0], name, bench->expanded[1],
+           (double)bench->expanded[0] / (bench->expanded[1] ? bench->expanded[1] : 1),
+           bench->elapsedMs[0], name, bench->elapsedMs[1],
+           bench->elapsedMs[0] / (bench->elapsedMs[1] > 0 ? bench->elapsedMs[1] : 1),
+           bench->mismatches,
+           100.0 * (bench->steps[1] - bench->steps[0]) / (bench->steps[0] ? bench->steps[0] : 1),
+           bench->setupMs);
+    if (bench->flips > 0) printFlipCheck(shape, bench);
+}
+
+void runPathBenchmark(PathAlgorithm algorithm, unsigned int firstSeed,
+                      unsigned int lastSeed, int width, int height) {
+    int size[2] = {width, height};
+    for (int shape = 0; shape < SHAPE_COUNT; shape++) {
+        PathBenchmark bench = {0};
+        unsigned int seed = firstSeed;
+        do {
+            benchmarkSeed(seed, shape, size, algorithm, &bench);
+        } while (seed++ != lastSeed);
+        printBenchmark(shape, algorithm, &bench);
+    }
+}
+
+/* Queries are drawn from each record's own seed, so a corpus always gets
+   the same ones */
+void runCorpusBenchmark(PathAlgorithm algorithm, const ArenaRecord *arenas, int count) {
+    PathBenchmark benches[SHAPE_COUNT] = {0};
+    for (int i = 0; i < count; i++) {
+        Arena arena;
+        ShapeType shape = arenas[i].header->shape;
+        seedRandom(arenas[i].header->seed);
+        if (!loadCorpusArena(&arenas[i], &arena)) continue;
+        benchmarkArena(&arena, algorithm, &benches[shape]);
+        freeArena(&arena);
+    }
+    for (int shape = 0; shape < SHAPE_COUNT; shape++) {
+        if (benches[shape].queries > 0) printBenchmark(shape, algorithm, &benches[shape]);
+    }
+}
@@ -0,0 +1,25 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#include "arenafile.h"
+#include "pathfinding.h"
+
+#define BENCH_QUERIES_PER_ARENA 50
+/* Distance field queries share this many goals per arena, the repeated
+   target case the cache is for */
+#define BENCH_FIELD_TARGETS 4
+/* Tiles hpa flips per arena to check its incremental rebuild */
+#define BENCH_FLIPS_PER_ARENA 10
+
+double currentTimeMs(void);
+
+/* Times algorithm against BFS on random point-to-point queries in every
+   ShapeType, checking each path is valid and as short as the BFS one.
+   Zero width/height picks a random size per seed */
+void runPathBenchmark(PathAlgorithm algorithm, unsigned int firstSeed,
+                      unsigned int lastSeed, int width, int height);
+/* The same benchmark over arenas from a corpus file, one line per shape
+   the corpus holds */
+void runCorpusBenchmark(PathAlgorithm algorithm, const ArenaRecord *arenas, int count);
+
+#endif
@@ -0,0 +1,142 @@
+#include <stdlib.h>
+#include "pathsearch.h"
+#include "profile.h"
+
+/* Breadth-first search from both ends at once, a whole level of the smaller
+   frontier at a time. Each end stamps the tiles it reaches with its own
+   mark, one stamp array read telling unseen, own and other side apart, and
+   parent[tile] leads back towards that end. The start frontier fills the
+   workspace queue up from slot 0 and the end frontier down from the last
+   slot; a tile is queued once, so they never overlap. depth is the
+   distance from origin of the tiles still queued */
+typedef struct {
+    int *tiles;
+    int step;
+    int front, rear;
+    int depth;
+    int originX, originY;
+    unsigned int mark;
+} Frontier;
+
+/* best is the shortest start-to-end length seen through a meeting edge,
+   or -1; meetStart and meetEnd are that edge's tiles on each side */
+typedef struct {
+    PathWorkspace *workspace;
+    Frontier frontiers[2];
+    int expanded;
+    int best;
+    int meetStart, meetEnd;
+} BidirectionalSearch;
+
+static int *frontierSlot(Frontier *frontier, int index) {
+    return frontier->tiles + frontier->step * index;
+}
+
+static int frontierSize(const Frontier *frontier) {
+    return frontier->rear - frontier->front;
+}
+
+static void pushTile(PathWorkspace *workspace, Frontier *frontier, int tile, int parent) {
+    workspace->stamp[tile] = frontier->mark;
+    workspace->parent[tile] = parent;
+    *frontierSlot(frontier, frontier->rear++) = tile;
+}
+
+/* No meeting before this level means the path is at least the sum of both
+   depths, so the other side's tile is at its frontier's depth or one less.
+   The grid is bipartite: a tile's distance from an origin has the parity
+   of its Manhattan distance, which tells the two apart */
+static int otherDepth(BidirectionalSearch *search, Frontier *opposite, int other) {
+    int width = search->workspace->arena->width;
+    int manhattan = abs(other % width - opposite->originX) + abs(other / width - opposite->originY);
+    return (manhattan - opposite->depth) % 2 == 0 ? opposite->depth : opposite->depth - 1;
+}
+
+static void recordMeeting(BidirectionalSearch *search, Frontier *frontier, Frontier *opposite,
+                          int tile, int other) {
+    int length = frontier->depth + 1 + otherDepth(search, opposite, other);
+    int fromStart = frontier == &search->frontiers[0];
+    if (search->best >= 0 && length >= search->best) return;
+    search->best = length;
+    search->meetStart = fromStart ? tile : other;
+    search->meetEnd = fromStart ? other : tile;
+}
+
+static void visitNeighbours(BidirectionalSearch *search, Frontier *frontier, Frontier *opposite, int tile) {
+    PathWorkspace *workspace = search->workspace;
+    int width = workspace->arena->width;
+    int x = tile % width, y = tile / width;
+    for (int i = 0; i < 4; i++) {
+        int nx = x + DIRECTION_DX[i], ny = y + DIRECTION_DY[i], next = ny * width + nx;
+        if (!isPassable(workspace->arena, nx, ny)) continue;
+        if (workspace->stamp[next] == opposite->mark) {
+            recordMeeting(search, frontier, opposite, tile, next);
+        } else if (workspace->stamp[next] != frontier->mark) {
+            pushTile(workspace, frontier, next, tile);
+        }
+    }
+}
+
+/* Once a level has met the other side, no later level can do better */
+static void expandLevel(BidirectionalSearch *search, Frontier *frontier, Frontier *opposite) {
+    int levelEnd = frontier->rear;
+    PROFILE_PEAK(PROFILE_BFS_QUEUE, frontierSize(&search->frontiers[0]) + frontierSize(&search->frontiers[1]));
+    while (frontier->front < levelEnd) {
+        int tile = *frontierSlot(frontier, frontier->front++);
+        PROFILE_COUNT(PROFILE_EXPANDED, 1);
+        search->expanded++;
+        visitNeighbours(search, frontier, opposite, tile);
+    }
+    frontier->depth++;
+}
+
+static void searchBothEnds(BidirectionalSearch *search) {
+    Frontier *fromStart = &search->frontiers[0], *fromEnd = &search->frontiers[1];
+    while (search->best < 0 && frontierSize(fromStart) > 0 && frontierSize(fromEnd) > 0) {
+        if (frontierSize(fromStart) <= frontierSize(fromEnd)) expandLevel(search, fromStart, fromEnd);
+        else expandLevel(search, fromEnd, fromStart);
+    }
+}
+
+/* The start side's parents give the path up to meetStart; the end side's
+   lead on from meetEnd to the end */
+static int buildMeetingPath(BidirectionalSearch *search, int start, Path *path) {
+    PathWorkspace *workspace = search->workspace;
+    int width = workspace->arena->width;
+    if (search->best > path->capacity ||
+        !buildPathFromParents(workspace->arena, workspace->parent, start, search->meetStart, path)) {
+        return 0;
+    }
+    for (int tile = search->meetEnd;; tile = workspace->parent[tile]) {
+        path->x[path->length] = tile % width;
+        path->y[path->length] = tile / width;
+        path->length++;
+        if (workspace->parent[tile] == tile) return 1;
+    }
+}
+
+/* Each side gets its own stamp generation */
+static void initFrontiers(BidirectionalSearch *search, int startX, int startY, int endX, int endY) {
+    PathWorkspace *workspace = search->workspace;
+    beginSearch(workspace);
+    search->frontiers[0] = (Frontier){workspace->queue, 1, 0, 0, 0, startX, startY, workspace->generation};
+    search->frontiers[1] = (Frontier){workspace->queue + workspace->nodes - 1, -1, 0, 0, 0, endX, endY,
+                                      nextGeneration(workspace)};
+}
+
+int findPathBidirectional(PathWorkspace *workspace, int startX, int startY,
+                          int endX, int endY, Path *path) {
+    BidirectionalSearch search = {workspace, {{0}, {0}}, 0, -1, 0, 0};
+    int width = workspace->arena->width;
+    int start = startY * width + startX, end = endY * width + endX;
+    int found = 1;
+    initFrontiers(&search, startX, startY, endX, endY);
+    if (start != end) {
+        pushTile(workspace, &search.frontiers[0], start, start);
+        pushTile(workspace, &search.frontiers[1], end, end);
+        searchBothEnds(&search);
+        found = search.best >= 0 && buildMeetingPath(&search, start, path);
+    }
+    path->expanded = search.expanded;
+    return found;
+}
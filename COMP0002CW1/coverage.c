@@ -0,0 +1,195 @@
+#include <stdlib.h>
+#include "coverage.h"
+#include "pathfinding.h"
+
+#define NO_SEGMENT -1
+#define SEGMENT_FIELDS 12
+
+/* A segment is a maximal vertical run of free tiles in one column, numbered
+   column by column from the top; columnStart[x] is column x's first one.
+   A cell chains segments in adjacent columns through next/previous and ends
+   where a run splits, merges or stops. cornerCell maps the end tiles of a
+   cell's first and last segments to the cell plus one */
+typedef struct {
+    Arena *arena;
+    CoveragePlan *plan;
+    int segments;
+    int cells;
+    int *columnStart;
+    int *cornerCell;
+    int *top;
+    int *bottom;
+    int *column;
+    int *next;
+    int *previous;
+    int *leftCount;
+    int *rightCount;
+    int *leftOf;
+    int *cell;
+    int *cellFirst;
+    int *cellLast;
+    int *swept;
+} CoveragePlanner;
+
+static int startsRun(Arena *arena, int x, int y) {
+    return isPassable(arena, x, y) && !isPassable(arena, x, y - 1);
+}
+
+/* The border is impassable, so runs only start inside it */
+static int countSegments(Arena *arena) {
+    int count = 0;
+    for (int x = 1; x < arena->width - 1; x++) {
+        for (int y = 1; y < arena->height - 1; y++) count += startsRun(arena, x, y);
+    }
+    return count;
+}
+
+static int allocatePlanner(CoveragePlanner *planner, Arena *arena) {
+    size_t tiles = (size_t)arena->width * arena->height;
+    size_t segments = planner->segments = countSegments(arena);
+    planner->arena = arena;
+    planner->columnStart = calloc(arena->width + 1 + tiles + SEGMENT_FIELDS * segments, sizeof(int));
+    if (planner->columnStart == NULL) return 0;
+    planner->cornerCell = planner->columnStart + arena->width + 1;
+    int **fields[SEGMENT_FIELDS] = {&planner->top, &planner->bottom, &planner->column,
+        &planner->next, &planner->previous, &planner->leftCount, &planner->rightCount,
+        &planner->leftOf, &planner->cell, &planner->cellFirst, &planner->cellLast, &planner->swept};
+    for (int i = 0; i < SEGMENT_FIELDS; i++) *fields[i] = planner->cornerCell + tiles + i * segments;
+    return 1;
+}
+
+static void addSegment(CoveragePlanner *planner, int segment, int x, int y) {
+    planner->top[segment] = y;
+    planner->column[segment] = x;
+    while (isPassable(planner->arena, x, y + 1)) y++;
+    planner->bottom[segment] = y;
+    planner->next[segment] = NO_SEGMENT;
+    planner->previous[segment] = NO_SEGMENT;
+}
+
+static void findSegments(CoveragePlanner *planner) {
+    Arena *arena = planner->arena;
+    int count = 0;
+    for (int x = 0; x < arena->width; x++) {
+        planner->columnStart[x] = count;
+        for (int y = 1; y < arena->height - 1; y++) {
+            if (x > 0 && x < arena->width - 1 && startsRun(arena, x, y)) addSegment(planner, count++, x, y);
+        }
+    }
+    planner->columnStart[arena->width] = count;
+}
+
+/* Both columns are sorted top to bottom, so one merge pass finds every
+   overlapping pair between column x - 1 and column x */
+static void countOverlaps(CoveragePlanner *planner, int x) {
+    int i = planner->columnStart[x - 1], j = planner->columnStart[x];
+    while (i < planner->columnStart[x] && j < planner->columnStart[x + 1]) {
+        if (planner->top[i] <= planner->bottom[j] && planner->top[j] <= planner->bottom[i]) {
+            planner->rightCount[i]++;
+            planner->leftCount[j]++;
+            planner->leftOf[j] = i;
+        }
+        if (planner->bottom[i] < planner->bottom[j]) i++;
+        else j++;
+    }
+}
+
+/* A segment continues its left neighbour's cell only when each is the
+   other's sole overlap; any split or merge opens a new cell */
+static void assignCell(CoveragePlanner *planner, int segment) {
+    int left = planner->leftOf[segment];
+    if (planner->leftCount[segment] == 1 && planner->rightCount[left] == 1) {
+        planner->next[left] = segment;
+        planner->previous[segment] = left;
+        planner->cell[segment] = planner->cell[left];
+    } else {
+        planner->cell[segment] = planner->cells;
+        planner->cellFirst[planner->cells++] = segment;
+    }
+    planner->cellLast[planner->cell[segment]] = segment;
+}
+
+static void markCorners(CoveragePlanner *planner, int segment, int cell) {
+    int width = planner->arena->width, x = planner->column[segment];
+    planner->cornerCell[planner->top[segment] * width + x] = cell + 1;
+    planner->cornerCell[planner->bottom[segment] * width + x] = cell + 1;
+}
+
+static void decompose(CoveragePlanner *planner) {
+    findSegments(planner);
+    planner->cells = 0;
+    for (int x = 1; x < planner->arena->width; x++) {
+        countOverlaps(planner, x);
+        for (int s = planner->columnStart[x]; s < planner->columnStart[x + 1]; s++) assignCell(planner, s);
+    }
+    for (int cell = 0; cell < planner->cells; cell++) {
+        markCorners(planner, planner->cellFirst[cell], cell);
+        markCorners(planner, planner->cellLast[cell], cell);
+    }
+}
+
+static int isUnsweptCorner(void *context, int x, int y) {
+    CoveragePlanner *planner = context;
+    int cell = planner->cornerCell[y * planner->arena->width + x];
+    return cell != 0 && !planner->swept[cell - 1];
+}
+
+static void addWaypoint(CoveragePlan *plan, int x, int y) {
+    if (plan->count > 0 && plan->x[plan->count - 1] == x && plan->y[plan->count - 1] == y) return;
+    plan->x[plan->count] = x;
+    plan->y[plan->count++] = y;
+}
+
+/* Sweeps away from the entered corner's column, running each segment from
+   the end nearer the previous one so passes alternate down and up */
+static void sweepCell(CoveragePlanner *planner, int x, int y) {
+    int cell = planner->cornerCell[y * planner->arena->width + x] - 1;
+    int ascending = x == planner->column[planner->cellFirst[cell]];
+    planner->swept[cell] = 1;
+    int s = ascending ? planner->cellFirst[cell] : planner->cellLast[cell];
+    for (; s != NO_SEGMENT; s = ascending ? planner->next[s] : planner->previous[s]) {
+        int fromTop = abs(planner->top[s] - y) <= abs(planner->bottom[s] - y);
+        addWaypoint(planner->plan, planner->column[s], fromTop ? planner->top[s] : planner->bottom[s]);
+        y = fromTop ? planner->bottom[s] : planner->top[s];
+        addWaypoint(planner->plan, planner->column[s], y);
+    }
+}
+
+/* Greedy order: one BFS per cell to the closest unswept cell corner */
+static int orderCells(CoveragePlanner *planner, int x, int y) {
+    PathWorkspace workspace;
+    Path path;
+    int ok = initPath(&path, planner->arena->width * planner->arena->height) &&
+             initPathWorkspace(&workspace, planner->arena);
+    while (ok && findNearestPath(&workspace, x, y, isUnsweptCorner, planner, &path)) {
+        if (path.length > 0) x = path.x[path.length - 1];
+        if (path.length > 0) y = path.y[path.length - 1];
+        sweepCell(planner, x, y);
+        x = planner->plan->x[planner->plan->count - 1];
+        y = planner->plan->y[planner->plan->count - 1];
+    }
+    if (ok) freePathWorkspace(&workspace);
+    freePath(&path);
+    return ok;
+}
+
+int planCoverage(Arena *arena, int startX, int startY, CoveragePlan *plan) {
+    CoveragePlanner planner;
+    *plan = (CoveragePlan){0};
+    if (!allocatePlanner(&planner, arena)) return 0;
+    planner.plan = plan;
+    plan->x = malloc(4 * ((size_t)planner.segments + 1) * sizeof(int));
+    plan->y = plan->x != NULL ? plan->x + 2 * (planner.segments + 1) : NULL;
+    decompose(&planner);
+    plan->cells = planner.cells;
+    int planned = plan->x != NULL && orderCells(&planner, startX, startY);
+    free(planner.columnStart);
+    return planned;
+}
+
+void freeCoveragePlan(CoveragePlan *plan) {
+    free(plan->x);
+    plan->x = NULL;
+    plan->y = NULL;
+    plan->count = 0;
+}
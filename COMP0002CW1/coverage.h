@@ -0,0 +1,23 @@
+#ifndef COVERAGE_H
+#define COVERAGE_H
+
+#include "arena.h"
+
+/* Waypoints of a boustrophedon sweep in visiting order. Consecutive
+   waypoints in one cell are the ends of a column run; the robot reaches
+   each one along a shortest path. cells counts the decomposition */
+typedef struct {
+    int *x;
+    int *y;
+    int count;
+    int cells;
+} CoveragePlan;
+
+/* Splits the free area into boustrophedon cells using the full map,
+   then sweeps the cells reachable from the start in lawnmower passes,
+   choosing the nearest unswept cell corner each time. Returns 0 if out
+   of memory */
+int planCoverage(Arena *arena, int startX, int startY, CoveragePlan *plan);
+void freeCoveragePlan(CoveragePlan *plan);
+
+#endif
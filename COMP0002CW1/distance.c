@@ -0,0 +1,124 @@
+#include <stdlib.h>
+#include "pathsearch.h"
+#include "profile.h"
+
+#define DISTANCE_CACHE_SIZE 8
+#define UNREACHABLE -1
+
+/* distance[tile] is the step count from tile to target, or UNREACHABLE.
+   A field stays valid while the arena's passable_version is unchanged */
+typedef struct {
+    int target;
+    unsigned int version;
+    unsigned long lastUsed;
+    int *distance;
+} DistanceField;
+
+/* Allocated together with the fields' distance arrays and queue, the
+   scratch space for building a field */
+struct DistanceFieldCache {
+    Arena *arena;
+    DistanceField fields[DISTANCE_CACHE_SIZE];
+    int *queue;
+    unsigned long clock;
+};
+
+static DistanceFieldCache *createDistanceFields(Arena *arena) {
+    size_t tiles = (size_t)arena->width * arena->height;
+    DistanceFieldCache *cache = malloc(sizeof(DistanceFieldCache) +
+                                       tiles * (DISTANCE_CACHE_SIZE + 1) * sizeof(int));
+    if (cache == NULL) return NULL;
+    cache->arena = arena;
+    cache->queue = (int *)(cache + 1);
+    cache->clock = 0;
+    for (int i = 0; i < DISTANCE_CACHE_SIZE; i++) {
+        cache->fields[i] = (DistanceField){-1, 0, 0, cache->queue + (i + 1) * tiles};
+    }
+    return cache;
+}
+
+void freeDistanceFields(DistanceFieldCache *cache) {
+    free(cache);
+}
+
+static void enqueueNeighbours(DistanceFieldCache *cache, int *distance, int tile, int *rear) {
+    int width = cache->arena->width;
+    for (int i = 0; i < 4; i++) {
+        int x = tile % width + DIRECTION_DX[i], y = tile / width + DIRECTION_DY[i];
+        int next = y * width + x;
+        if (!isPassable(cache->arena, x, y) || distance[next] != UNREACHABLE) continue;
+        distance[next] = distance[tile] + 1;
+        cache->queue[(*rear)++] = next;
+    }
+}
+
+/* BFS outward from the target; moves are symmetric, so these are also the
+   distances towards it. Returns the number of tiles expanded */
+static int buildField(DistanceFieldCache *cache, DistanceField *field, int target) {
+    int tiles = cache->arena->width * cache->arena->height;
+    int front = 0, rear = 0;
+    for (int tile = 0; tile < tiles; tile++) field->distance[tile] = UNREACHABLE;
+    field->distance[target] = 0;
+    cache->queue[rear++] = target;
+    while (front < rear) {
+        enqueueNeighbours(cache, field->distance, cache->queue[front++], &rear);
+    }
+    return rear;
+}
+
+static DistanceField *leastRecentlyUsed(DistanceFieldCache *cache) {
+    DistanceField *oldest = &cache->fields[0];
+    for (int i = 1; i < DISTANCE_CACHE_SIZE; i++) {
+        if (cache->fields[i].lastUsed < oldest->lastUsed) oldest = &cache->fields[i];
+    }
+    return oldest;
+}
+
+/* Returns the field for target, rebuilding the least recently used one on
+   a miss; *expanded is 0 on a hit */
+static DistanceField *lookupField(DistanceFieldCache *cache, int target, int *expanded) {
+    DistanceField *field = NULL;
+    for (int i = 0; i < DISTANCE_CACHE_SIZE && field == NULL; i++) {
+        DistanceField *entry = &cache->fields[i];
+        if (entry->target == target && entry->version == cache->arena->passable_version) field = entry;
+    }
+    *expanded = 0;
+    if (field == NULL) {
+        field = leastRecentlyUsed(cache);
+        *expanded = buildField(cache, field, target);
+        field->target = target;
+        field->version = cache->arena->passable_version;
+    }
+    field->lastUsed = ++cache->clock;
+    return field;
+}
+
+/* Each step moves to a neighbour one closer to the target */
+static void descendField(Arena *arena, const int *distance, int tile, Path *path) {
+    int width = arena->width;
+    for (int step = 0; distance[tile] > 0; step++) {
+        int i = 0;
+        while (distance[tile + DIRECTION_DY[i] * width + DIRECTION_DX[i]] != distance[tile] - 1) i++;
+        tile += DIRECTION_DY[i] * width + DIRECTION_DX[i];
+        path->x[step] = tile % width;
+        path->y[step] = tile / width;
+    }
+}
+
+/* Builds a field per new target; repeat queries cost O(path length) */
+int findPathDistanceField(PathWorkspace *workspace, int startX, int startY,
+                          int endX, int endY, Path *path) {
+    Arena *arena = workspace->arena;
+    if (workspace->fields == NULL) workspace->fields = createDistanceFields(arena);
+    if (workspace->fields == NULL) return 0;
+
+    DistanceField *field = lookupField(workspace->fields, endY * arena->width + endX, &path->expanded);
+    PROFILE_COUNT(PROFILE_SEARCHES, 1);
+    PROFILE_COUNT(PROFILE_EXPANDED, path->expanded);
+    int start = startY * arena->width + startX;
+    int length = field->distance[start];
+    if (length == UNREACHABLE || length > path->capacity) return 0;
+    path->length = length;
+    descendField(arena, field->distance, start, path);
+    return 1;
+}
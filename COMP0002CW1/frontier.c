@@ -0,0 +1,36 @@
+#include <stdlib.h>
+#include "frontier.h"
+
+int initFrontierSet(FrontierSet *set, int tileCount) {
+    set->tiles = calloc(2 * (size_t)tileCount, sizeof(int));
+    set->slot = set->tiles != NULL ? set->tiles + tileCount : NULL;
+    set->count = 0;
+    return set->tiles != NULL;
+}
+
+void freeFrontierSet(FrontierSet *set) {
+    free(set->tiles);
+    set->tiles = NULL;
+    set->slot = NULL;
+    set->count = 0;
+}
+
+int frontierContains(FrontierSet *set, int tile) {
+    return set->slot[tile] != 0;
+}
+
+void addFrontierTile(FrontierSet *set, int tile) {
+    if (frontierContains(set, tile)) return;
+    set->tiles[set->count++] = tile;
+    set->slot[tile] = set->count;
+}
+
+/* Moves the last tile into the freed position */
+void removeFrontierTile(FrontierSet *set, int tile) {
+    if (!frontierContains(set, tile)) return;
+    int position = set->slot[tile] - 1;
+    int last = set->tiles[--set->count];
+    set->tiles[position] = last;
+    set->slot[last] = position + 1;
+    set->slot[tile] = 0;
+}
@@ -0,0 +1,19 @@
+#ifndef FRONTIER_H
+#define FRONTIER_H
+
+/* Indexed set of tile indices with O(1) add, remove and membership.
+   tiles is dense; slot[tile] is the tile's position in tiles plus one,
+   or 0 when absent, so a zeroed allocation is an empty set */
+typedef struct {
+    int *tiles;
+    int *slot;
+    int count;
+} FrontierSet;
+
+int initFrontierSet(FrontierSet *set, int tileCount);
+void freeFrontierSet(FrontierSet *set);
+int frontierContains(FrontierSet *set, int tile);
+void addFrontierTile(FrontierSet *set, int tile);
+void removeFrontierTile(FrontierSet *set, int tile);
+
+#endif
@@ -2,192 +2,348 @@
 #include <stdlib.h>
 #include <string.h>
 #include "graphics.h"
+#include "profile.h"
 
-char* replaceNewlineWithEntity(const char* s)
+#define OUTPUT_BUFFER_SIZE 65536
+
+/* Commands are formatted here and written out in large blocks at frame
+   boundaries (foreground, sleep) or when the buffer fills */
+static char outputBuffer[OUTPUT_BUFFER_SIZE];
+static size_t outputLength = 0;
+static int flushRegistered = 0;
+static CommandBlock* recordingBlock = NULL;
+
+/* Each command's formatted bytes are the growth of flushedBytes +
+   outputLength while it is emitted */
+#ifdef NO_PROFILE
+#define BEGIN_COMMAND()
+#define END_COMMAND(code) ((void)0)
+#else
+static size_t flushedBytes = 0;
+#define BEGIN_COMMAND() size_t commandStart = flushedBytes + outputLength
+#define END_COMMAND(code) profileDraw(code, flushedBytes + outputLength - commandStart)
+#endif
+
+/* A block that can't grow is marked failed and takes nothing more, so it
+   is never replayed with commands missing */
+static void appendToBlock(CommandBlock* block, const char* data, size_t length)
+{
+  if (block->failed) return;
+  if (block->length + length > block->capacity)
+  {
+    size_t capacity = block->capacity ? block->capacity : OUTPUT_BUFFER_SIZE;
+    while (capacity < block->length + length) capacity *= 2;
+    char* grown = (char*)realloc(block->data, capacity);
+    block->failed = grown == NULL;
+    if (grown == NULL) return;
+    block->data = grown;
+    block->capacity = capacity;
+  }
+  memcpy(block->data + block->length, data, length);
+  block->length += length;
+}
+
+static void writeOutput(const char* data, size_t length)
+{
+  if (recordingBlock != NULL)
+  {
+    appendToBlock(recordingBlock, data, length);
+    return;
+  }
+  fwrite(data, 1, length, stdout);
+  fflush(stdout);
+}
+
+static void flushOutput(void)
 {
-  if (s == NULL) return NULL;
+  if (outputLength == 0) return;
+  writeOutput(outputBuffer, outputLength);
+#ifndef NO_PROFILE
+  flushedBytes += outputLength;
+#endif
+  outputLength = 0;
+}
+
+static void reserveOutput(size_t length)
+{
+  if (!flushRegistered)
+  {
+    atexit(flushOutput);
+    flushRegistered = 1;
+  }
+  if (outputLength + length > OUTPUT_BUFFER_SIZE) flushOutput();
+}
+
+static void emitChar(char c)
+{
+  reserveOutput(1);
+  outputBuffer[outputLength++] = c;
+}
+
+static void emitText(const char* s)
+{
+  size_t length = strlen(s);
+  if (length > OUTPUT_BUFFER_SIZE)
+  {
+    flushOutput();
+    writeOutput(s, length);
+#ifndef NO_PROFILE
+    flushedBytes += length;
+#endif
+    return;
+  }
+  reserveOutput(length);
+  memcpy(outputBuffer + outputLength, s, length);
+  outputLength += length;
+}
+
+/* Newlines would end the command early, so drawapp takes them as &#10; */
+static void emitEntityText(const char* s)
+{
+  for (; *s != '\0'; s++)
+  {
+    if (*s == '\n') emitText("&#10;");
+    else if (*s != '\r') emitChar(*s);
+  }
+}
+
+static void emitInt(int value)
+{
+  char digits[12];
+  int count = 0;
+  unsigned int magnitude = value < 0 ? 0u - (unsigned int)value : (unsigned int)value;
+
+  reserveOutput(sizeof digits);
+  do
+  {
+    digits[count++] = (char)('0' + magnitude % 10);
+    magnitude /= 10;
+  } while (magnitude > 0);
+  if (value < 0) outputBuffer[outputLength++] = '-';
+  while (count > 0) outputBuffer[outputLength++] = digits[--count];
+}
 
-  size_t len = strlen(s);
-  size_t new_len = 0;
-  for (size_t i = 0; i < len; ++i)
+static void emitArguments(const char* code, int count, const int values[])
+{
+  emitText(code);
+  for (int n = 0; n < count; n++)
   {
-    if (s[i] == '\n')
-    {
-      new_len += 5;
-      continue;
-    }
-    if (s[i] != '\r')
-    {
-      new_len += 1;
-    }
+    emitChar(' ');
+    emitInt(values[n]);
   }
+}
+
+static void emitCommand(const char* code, int count, const int values[])
+{
+  BEGIN_COMMAND();
+  emitArguments(code, count, values);
+  emitChar('\n');
+  END_COMMAND(code);
+}
+
+static void emitStringCommand(const char* code, int count, const int values[], const char* s)
+{
+  BEGIN_COMMAND();
+  emitArguments(code, count, values);
+  emitText(" @");
+  emitText(s);
+  emitChar('\n');
+  END_COMMAND(code);
+}
 
-  char* out = (char*)malloc(new_len + 1);
-  if (out == NULL) return NULL;
+/* A command with no arguments, such as "CL" */
+static void emitBareCommand(const char* code)
+{
+  BEGIN_COMMAND();
+  emitText(code);
+  emitChar('\n');
+  END_COMMAND(code);
+}
 
-  char* p = out;
-  for (size_t i = 0; i < len; ++i)
+static void emitPolygon(const char* code, int count, int x[], int y[])
+{
+  BEGIN_COMMAND();
+  emitText(code);
+  emitChar(' ');
+  emitInt(count);
+  emitChar(' ');
+  for (int n = 0; n < count; n++)
   {
-    if (s[i] == '\n')
-    {
-      memcpy(p, "&#10;", 5);
-      p += 5;
-      continue;
-    }
-    if (s[i] != '\r')
-    {
-      *p++ = s[i];
-    }
+    emitInt(x[n]);
+    emitChar(' ');
+    emitInt(y[n]);
+    emitChar(' ');
   }
-  *p = '\0';
-  return out;
+  emitChar('\n');
+  END_COMMAND(code);
 }
 
 void setLineWidth(int width)
 {
-  printf("LW %i\n", width);
+  emitCommand("LW", 1, (int[]){width});
 }
 
 void drawLine(int x1, int x2, int x3, int x4)
 {
-  printf("DL %i %i %i %i\n", x1, x2, x3, x4);
+  emitCommand("DL", 4, (int[]){x1, x2, x3, x4});
 }
 
 void drawRect(int x1, int x2, int x3, int x4)
 {
-  printf("DR %i %i %i %i\n", x1, x2, x3, x4);
+  emitCommand("DR", 4, (int[]){x1, x2, x3, x4});
 }
 
 void drawRectRotated(int x, int y, int width, int height, int angle)
 {
-  printf("DT %i %i %i %i %i\n", x, y, width, height, angle);
+  emitCommand("DT", 5, (int[]){x, y, width, height, angle});
 }
 
 void fillRect(int x1, int x2, int x3, int x4)
 {
-  printf("FR %i %i %i %i\n", x1, x2, x3, x4);
+  emitCommand("FR", 4, (int[]){x1, x2, x3, x4});
 }
 
 void fillRectRotated(int x, int y, int width, int height, int angle)
 {
-  printf("FT %i %i %i %i %i\n", x, y, width, height, angle);
+  emitCommand("FT", 5, (int[]){x, y, width, height, angle});
 }
 
 void drawOval(int x, int y, int width, int height)
 {
-  printf("DO %i %i %i %i\n",x,y,width,height);
+  emitCommand("DO", 4, (int[]){x, y, width, height});
 }
 
 void fillOval(int x, int y, int width, int height)
 {
-  printf("FO %i %i %i %i\n",x,y,width,height);
+  emitCommand("FO", 4, (int[]){x, y, width, height});
 }
 
 void drawArc(int x, int y, int width, int height, int startAngle, int arcAngle)
 {
-  printf("DA %i %i %i %i %i %i\n",x,y,width,height, startAngle, arcAngle);
+  emitCommand("DA", 6, (int[]){x, y, width, height, startAngle, arcAngle});
 }
 
 void fillArc(int x, int y, int width, int height, int startAngle, int arcAngle)
 {
-  printf("FA %i %i %i %i %i %i\n",x,y,width,height, startAngle, arcAngle);
+  emitCommand("FA", 6, (int[]){x, y, width, height, startAngle, arcAngle});
 }
 
 void drawPolygon(int count, int x[], int y[])
 {
-  printf("DP ");
-  printf("%d ", count);
-  for (int n = 0 ; n < count ; n++)
-  {
-    printf("%d %d ", x[n], y[n]);
-  }
-  printf("\n");
+  emitPolygon("DP", count, x, y);
 }
 
 void fillPolygon(int count, int x[], int y[])
 {
-  printf("FP ");
-  printf("%d ", count);
-  for (int n = 0 ; n < count ; n++)
-  {
-    printf("%d %d ", x[n], y[n]);
-  }
-  printf("\n");
+  emitPolygon("FP", count, x, y);
 }
 
 void drawString(char* s, int x, int y)
 {
-  printf("DS %i %i @%s\n",x,y,s);
+  emitStringCommand("DS", 2, (int[]){x, y}, s);
 }
 
 void drawStringRotated(char* s, int x, int y, int angle)
 {
-  printf("SR %i %i %i @%s\n",x,y,angle,s);
+  emitStringCommand("SR", 3, (int[]){x, y, angle}, s);
 }
 
 void setStringTextSize(int size)
 {
-  printf("SZ %i\n", size);
+  emitCommand("SZ", 1, (int[]){size});
 }
 
 void displayImage(char* fileName, int x, int y)
 {
-  printf("DI %i %i @%s\n", x, y, fileName );
+  emitStringCommand("DI", 2, (int[]){x, y}, fileName);
+}
+
+/* Names in the order of the colour enum; anything else is black */
+static const char* colourName(colour c)
+{
+  static const char* names[] = {"black", "blue", "cyan", "darkgray", "gray", "green", "lightgray",
+                                "magenta", "orange", "pink", "red", "white", "yellow"};
+  return c >= black && c <= yellow ? names[c] : "black";
 }
 
 void setColour(colour c)
 {
-  char* colourName;
-  switch(c)
-  {
-    case black : colourName = "black"; break;
-    case blue : colourName = "blue"; break;
-    case cyan : colourName = "cyan"; break;
-    case darkgray : colourName = "darkgray"; break;
-    case gray : colourName = "gray"; break;
-    case green : colourName = "green"; break;
-    case lightgray : colourName = "lightgray"; break;
-    case magenta : colourName = "magenta"; break;
-    case orange : colourName = "orange"; break;
-    case pink : colourName = "pink"; break;
-    case red : colourName = "red"; break;
-    case white : colourName = "white"; break;
-    case yellow : colourName = "yellow"; break;
-  }
-  printf("SC %s\n", colourName);
+  BEGIN_COMMAND();
+  emitText("SC ");
+  emitText(colourName(c));
+  emitChar('\n');
+  END_COMMAND("SC");
 }
 
 void setRGBColour(int red, int green, int blue)
 {
-  printf("RG %i %i %i\n", red, green, blue);
+  emitCommand("RG", 3, (int[]){red, green, blue});
 }
 
 void clear(void)
 {
-  printf("CL\n");
+  emitBareCommand("CL");
 }
 
 void setWindowSize(int width, int height)
 {
-  printf("SW %i %i\n", width, height);
+  emitCommand("SW", 2, (int[]){width, height});
 }
 
 void sleep(int time)
 {
-  printf("SL %i\n", time);
+  emitCommand("SL", 1, (int[]){time});
+  flushOutput();
 }
 
 void foreground(void)
 {
-  printf("FG\n");
+  emitBareCommand("FG");
+  flushOutput();
 }
 
 void background(void)
 {
-  printf("BG\n");
+  emitBareCommand("BG");
 }
 
 void message(char *s)
 {
-  printf("MS @%s\n", replaceNewlineWithEntity(s));
-}
\ No newline at end of file
+  BEGIN_COMMAND();
+  emitText("MS @");
+  emitEntityText(s);
+  emitChar('\n');
+  END_COMMAND("MS");
+}
+
+void beginCommandBlock(CommandBlock* block)
+{
+  flushOutput();
+  block->length = 0;
+  block->failed = 0;
+  recordingBlock = block;
+}
+
+int endCommandBlock(void)
+{
+  flushOutput();
+  int recorded = !recordingBlock->failed;
+  recordingBlock = NULL;
+  return recorded;
+}
+
+void drawCommandBlock(CommandBlock* block)
+{
+  flushOutput();
+  if (block->length > 0) writeOutput(block->data, block->length);
+  PROFILE_COUNT(PROFILE_BLOCK_BYTES, block->length);
+}
+
+void freeCommandBlock(CommandBlock* block)
+{
+  free(block->data);
+  block->data = NULL;
+  block->length = 0;
+  block->capacity = 0;
+  block->failed = 0;
+}
@@ -1,3 +1,8 @@
+#ifndef GRAPHICS_H
+#define GRAPHICS_H
+
+#include <stddef.h>
+
 enum colour {black,blue,cyan,darkgray,gray,green,lightgray,magenta,orange,pink,red,white,yellow};
 typedef enum colour colour;
 
@@ -32,3 +37,20 @@ void sleep(int);
 
 void message(char*);
 
+/* Commands recorded between beginCommandBlock and endCommandBlock are kept
+   instead of sent, and drawCommandBlock replays them in a single write.
+   failed is set when the block ran out of memory; endCommandBlock then
+   returns 0 and the commands must be sent again without recording */
+typedef struct {
+  char* data;
+  size_t length;
+  size_t capacity;
+  int failed;
+} CommandBlock;
+
+void beginCommandBlock(CommandBlock*);
+int endCommandBlock(void);
+void drawCommandBlock(CommandBlock*);
+void freeCommandBlock(CommandBlock*);
+
+#endif
@@ -0,0 +1,126 @@
+#include <limits.h>
+#include <stdlib.h>
+#include "pathsearch.h"
+
+/* Search nodes are tile * 4 + heading, heading indexing DIRECTION_DX.
+   Without a goal function the search stops on the end tile in any heading */
+typedef struct {
+    int moveCost;
+    int turnCost;
+    TileGoal goal;
+    void *goalContext;
+} HeadingQuery;
+
+static PathWorkspace *headingWorkspace(PathWorkspace *workspace) {
+    if (workspace->headings != NULL || workspace->nodes > INT_MAX / 4) return workspace->headings;
+    PathWorkspace *headings = malloc(sizeof(PathWorkspace));
+    if (headings != NULL && !initWorkspaceNodes(headings, workspace->arena, 4 * workspace->nodes)) {
+        free(headings);
+        headings = NULL;
+    }
+    workspace->headings = headings;
+    return headings;
+}
+
+void freeHeadingWorkspace(PathWorkspace *workspace) {
+    if (workspace->headings == NULL) return;
+    freePathWorkspace(workspace->headings);
+    free(workspace->headings);
+    workspace->headings = NULL;
+}
+
+/* Each forward step costs at least moveCost and turns never move, so the
+   scaled Manhattan distance stays consistent */
+static int headingEstimate(AStarSearch *search, int node) {
+    HeadingQuery *query = search->context;
+    int dx = (node >> 2) % search->arena->width - search->endX;
+    int dy = (node >> 2) / search->arena->width - search->endY;
+    return query->goal != NULL ? 0 : (abs(dx) + abs(dy)) * query->moveCost;
+}
+
+static int reachedHeadingGoal(AStarSearch *search, int node) {
+    HeadingQuery *query = search->context;
+    int width = search->arena->width, tile = node >> 2;
+    if (query->goal == NULL) return tile == search->end;
+    return query->goal(query->goalContext, tile % width, tile / width);
+}
+
+/* Move one tile ahead, or turn a quarter either way in place */
+static void expandHeading(AStarSearch *search, int node) {
+    HeadingQuery *query = search->context;
+    int tile = node >> 2, heading = node & 3, width = search->arena->width;
+    int x = tile % width + DIRECTION_DX[heading], y = tile / width + DIRECTION_DY[heading];
+    if (isPassable(search->arena, x, y)) {
+        relaxSuccessor(search, node, (y * width + x) << 2 | heading, query->moveCost);
+    }
+    relaxSuccessor(search, node, tile << 2 | (heading + 1) % 4, query->turnCost);
+    relaxSuccessor(search, node, tile << 2 | (heading + 3) % 4, query->turnCost);
+}
+
+/* Turn nodes share a tile with their parent and add no path step */
+static int buildHeadingPath(AStarSearch *search, int goal, Path *path) {
+    int width = search->arena->width, len = 0;
+    for (int node = goal; search->parent[node] != node; node = search->parent[node]) {
+        if (search->parent[node] >> 2 != node >> 2) len++;
+    }
+    if (len > path->capacity) return 0;
+    path->length = len;
+    for (int node = goal; search->parent[node] != node; node = search->parent[node]) {
+        if (search->parent[node] >> 2 == node >> 2) continue;
+        len--;
+        path->x[len] = (node >> 2) % width;
+        path->y[len] = (node >> 2) / width;
+    }
+    return 1;
+}
+
+static void initHeadingSearch(AStarSearch *search, PathWorkspace *headings, HeadingQuery *query,
+                              int endX, int endY) {
+    initAStar(search, headings, endX, endY);
+    search->expand = expandHeading;
+    search->estimate = headingEstimate;
+    search->reached = reachedHeadingGoal;
+    search->context = query;
+}
+
+/* A negative heading lets the search start facing any direction */
+static int runHeadingSearch(PathWorkspace *workspace, HeadingQuery *query, const int start[3],
+                            int endX, int endY, Path *path) {
+    PathWorkspace *headings = headingWorkspace(workspace);
+    AStarSearch search;
+    int found = 0;
+    if (headings == NULL) return 0;
+    initHeadingSearch(&search, headings, query, endX, endY);
+    for (int heading = 0; heading < 4; heading++) {
+        if (start[2] < 0 || heading == start[2]) {
+            addSearchStart(&search, (start[1] * workspace->arena->width + start[0]) << 2 | heading);
+        }
+    }
+    int goal = astarSearch(&search);
+    if (goal >= 0) found = buildHeadingPath(&search, goal, path);
+    path->expanded = search.expanded;
+    return found;
+}
+
+int findPathHeading(PathWorkspace *workspace, int startX, int startY,
+                    int endX, int endY, Path *path) {
+    return findPathTurning(workspace, startX, startY, -1, endX, endY, path);
+}
+
+int findPathTurning(PathWorkspace *workspace, int startX, int startY, int heading,
+                    int endX, int endY, Path *path) {
+    HeadingQuery query = {workspace->moveCost, workspace->turnCost, NULL, NULL};
+    int start[3] = {startX, startY, heading};
+    path->length = 0;
+    path->expanded = 0;
+    return runHeadingSearch(workspace, &query, start, endX, endY, path);
+}
+
+int findNearestPathTurning(PathWorkspace *workspace, int startX, int startY, int heading,
+                           TileGoal goal, void *context, Path *path) {
+    HeadingQuery query = {workspace->moveCost, workspace->turnCost, goal, context};
+    int start[3] = {startX, startY, heading};
+    path->length = 0;
+    path->expanded = 0;
+    return runHeadingSearch(workspace, &query, start, startX, startY, path);
+}
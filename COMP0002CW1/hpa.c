@@ -0,0 +1,446 @@
+#include <stdlib.h>
+#include "pathsearch.h"
+#include "profile.h"
+
+/* Hierarchical path search (HPA*). The arena is cut into square clusters;
+   wherever both sides of a cluster border are open, the entrance's middle
+   tile (or both end tiles, for wide entrances) becomes a pair of abstract
+   nodes joined by a one-step edge. Nodes of a cluster are joined by their
+   shortest distance inside it, found once per cluster. A query links start
+   and goal to their clusters' nodes, runs A* over the abstract graph and
+   refines each abstract edge back into tiles with a search inside one
+   cluster. Paths can be a little longer than BFS ones, since they only
+   cross borders at entrance tiles */
+
+#define CLUSTER_SIZE 16
+#define CLUSTER_TILES (CLUSTER_SIZE * CLUSTER_SIZE)
+/* A border holds at most 8 one-tile entrances */
+#define MAX_CLUSTER_NODES 32
+/* Entrances at least this wide get a node at each end */
+#define WIDE_ENTRANCE 6
+#define NO_DISTANCE 0xFFFF
+
+/* tiles[i] is node i's tile and across[i] the tiles it steps to over a
+   border (a corner tile can sit on two), or -1 */
+typedef struct {
+    int count;
+    int tiles[MAX_CLUSTER_NODES];
+    int across[MAX_CLUSTER_NODES][2];
+    uint16_t distance[MAX_CLUSTER_NODES][MAX_CLUSTER_NODES];
+} Cluster;
+
+/* Abstract node ids are cluster * MAX_CLUSTER_NODES + index, then the
+   query's start and goal. dirty clusters are rebuilt before the next
+   query. version is the arena's passable_version when the graph was last
+   current and reported the flips invalidatePathTile has heard of since.
+   distance and queue are scratch space for searches inside one cluster */
+struct HierarchyGraph {
+    Arena *arena;
+    int clustersWide, clustersHigh;
+    Cluster *clusters;
+    unsigned char *dirty;
+    int dirtyCount;
+    unsigned int version;
+    unsigned int reported;
+    PathWorkspace search;
+    int distance[CLUSTER_TILES];
+    int queue[CLUSTER_TILES];
+};
+
+/* Tiles over the border from a cluster's side, going along it */
+typedef struct {
+    int x, y;
+    int alongX, alongY;
+    int acrossX, acrossY;
+    int length;
+} Border;
+
+/* One query's start and goal, linked to the nodes of their clusters.
+   direct is the start-to-goal distance inside a shared cluster */
+typedef struct {
+    HierarchyGraph *graph;
+    int startTile, goalTile;
+    int startNode, goalNode;
+    int startCluster, goalCluster;
+    int startDistance[MAX_CLUSTER_NODES];
+    int goalDistance[MAX_CLUSTER_NODES];
+    int direct;
+    int expanded;
+} HierarchyQuery;
+
+static int clusterOf(HierarchyGraph *graph, int tile) {
+    int width = graph->arena->width;
+    return tile / width / CLUSTER_SIZE * graph->clustersWide + tile % width / CLUSTER_SIZE;
+}
+
+static void clusterBounds(HierarchyGraph *graph, int cluster, int bounds[4]) {
+    bounds[0] = cluster % graph->clustersWide * CLUSTER_SIZE;
+    bounds[1] = cluster / graph->clustersWide * CLUSTER_SIZE;
+    bounds[2] = bounds[0] + CLUSTER_SIZE < graph->arena->width ? bounds[0] + CLUSTER_SIZE : graph->arena->width;
+    bounds[3] = bounds[1] + CLUSTER_SIZE < graph->arena->height ? bounds[1] + CLUSTER_SIZE : graph->arena->height;
+}
+
+static int localIndex(const int bounds[4], int x, int y) {
+    return (y - bounds[1]) * CLUSTER_SIZE + (x - bounds[0]);
+}
+
+static int isInside(const int bounds[4], int x, int y) {
+    return x >= bounds[0] && x < bounds[2] && y >= bounds[1] && y < bounds[3];
+}
+
+/* Queues current's unreached open neighbours inside the cluster and
+   returns the new queue end */
+static int queueClusterNeighbours(HierarchyGraph *graph, const int bounds[4], int current, int rear) {
+    int width = graph->arena->width, x = current % width, y = current / width;
+    int base = graph->distance[localIndex(bounds, x, y)];
+    for (int i = 0; i < 4; i++) {
+        int nx = x + DIRECTION_DX[i], ny = y + DIRECTION_DY[i];
+        if (!isInside(bounds, nx, ny) || !isPassable(graph->arena, nx, ny) ||
+            graph->distance[localIndex(bounds, nx, ny)] >= 0) continue;
+        graph->distance[localIndex(bounds, nx, ny)] = base + 1;
+        graph->queue[rear++] = ny * width + nx;
+    }
+    return rear;
+}
+
+/* BFS from tile over the cluster's own tiles, leaving graph->distance
+   indexed by localIndex, -1 where unreached. It stops once stop (-1 for
+   none) is reached; every tile closer than stop has its distance by then */
+static void searchCluster(HierarchyGraph *graph, const int bounds[4], int tile, int stop, int *expanded) {
+    int width = graph->arena->width, front = 0, rear = 0;
+    for (int i = 0; i < CLUSTER_TILES; i++) graph->distance[i] = -1;
+    graph->distance[localIndex(bounds, tile % width, tile / width)] = 0;
+    graph->queue[rear++] = tile;
+    while (front < rear && graph->queue[rear - 1] != stop) {
+        rear = queueClusterNeighbours(graph, bounds, graph->queue[front++], rear);
+    }
+    PROFILE_COUNT(PROFILE_EXPANDED, rear);
+    *expanded += rear;
+}
+
+static int distanceTo(HierarchyGraph *graph, const int bounds[4], int tile) {
+    int width = graph->arena->width;
+    return graph->distance[localIndex(bounds, tile % width, tile / width)];
+}
+
+static int findNode(HierarchyGraph *graph, int tile) {
+    int cluster = clusterOf(graph, tile);
+    Cluster *nodes = &graph->clusters[cluster];
+    for (int i = 0; i < nodes->count; i++) {
+        if (nodes->tiles[i] == tile) return cluster * MAX_CLUSTER_NODES + i;
+    }
+    return -1;
+}
+
+static void addNode(Cluster *nodes, int tile, int across) {
+    int i = 0;
+    while (i < nodes->count && nodes->tiles[i] != tile) i++;
+    if (i == nodes->count) {
+        if (i == MAX_CLUSTER_NODES) return;
+        nodes->tiles[nodes->count++] = tile;
+        nodes->across[i][0] = across;
+        nodes->across[i][1] = -1;
+    } else {
+        nodes->across[i][1] = across;
+    }
+}
+
+/* The four borders, north, east, south and west; length is 0 where the
+   cluster sits on the arena's edge */
+static Border clusterBorder(HierarchyGraph *graph, const int bounds[4], int side) {
+    int dx = DIRECTION_DX[side], dy = DIRECTION_DY[side];
+    Border border = {dx > 0 ? bounds[2] - 1 : bounds[0], dy > 0 ? bounds[3] - 1 : bounds[1],
+                     dy != 0, dx != 0, dx, dy, dy != 0 ? bounds[2] - bounds[0] : bounds[3] - bounds[1]};
+    int outX = border.x + dx, outY = border.y + dy;
+    if (outX < 0 || outY < 0 || outX >= graph->arena->width || outY >= graph->arena->height) border.length = 0;
+    return border;
+}
+
+static int isOpenAt(HierarchyGraph *graph, const Border *border, int i) {
+    int x = border->x + border->alongX * i, y = border->y + border->alongY * i;
+    return isPassable(graph->arena, x, y) && isPassable(graph->arena, x + border->acrossX, y + border->acrossY);
+}
+
+static void addTransition(HierarchyGraph *graph, Cluster *nodes, const Border *border, int i) {
+    int width = graph->arena->width;
+    int x = border->x + border->alongX * i, y = border->y + border->alongY * i;
+    addNode(nodes, y * width + x, (y + border->acrossY) * width + x + border->acrossX);
+}
+
+/* Both clusters on a border find the same entrances, so each adds its own
+   side of every transition */
+static void addBorderNodes(HierarchyGraph *graph, Cluster *nodes, const Border *border) {
+    for (int i = 0; i < border->length; i++) {
+        if (!isOpenAt(graph, border, i)) continue;
+        int first = i;
+        while (i + 1 < border->length && isOpenAt(graph, border, i + 1)) i++;
+        if (i - first + 1 < WIDE_ENTRANCE) {
+            addTransition(graph, nodes, border, (first + i) / 2);
+        } else {
+            addTransition(graph, nodes, border, first);
+            addTransition(graph, nodes, border, i);
+        }
+    }
+}
+
+static void linkClusterNodes(HierarchyGraph *graph, Cluster *nodes, const int bounds[4]) {
+    int expanded = 0;
+    for (int i = 0; i < nodes->count; i++) {
+        searchCluster(graph, bounds, nodes->tiles[i], -1, &expanded);
+        for (int j = 0; j < nodes->count; j++) {
+            int distance = distanceTo(graph, bounds, nodes->tiles[j]);
+            nodes->distance[i][j] = distance >= 0 ? (uint16_t)distance : NO_DISTANCE;
+        }
+    }
+}
+
+static void buildCluster(HierarchyGraph *graph, int cluster) {
+    Cluster *nodes = &graph->clusters[cluster];
+    int bounds[4];
+    clusterBounds(graph, cluster, bounds);
+    nodes->count = 0;
+    for (int side = 0; side < 4; side++) {
+        Border border = clusterBorder(graph, bounds, side);
+        addBorderNodes(graph, nodes, &border);
+    }
+    linkClusterNodes(graph, nodes, bounds);
+    graph->dirty[cluster] = 0;
+}
+
+static void buildAllClusters(HierarchyGraph *graph) {
+    int count = graph->clustersWide * graph->clustersHigh;
+    for (int cluster = 0; cluster < count; cluster++) buildCluster(graph, cluster);
+    graph->dirtyCount = 0;
+    graph->version = graph->arena->passable_version;
+    graph->reported = 0;
+}
+
+/* Each flip bumps passable_version once, so any change that wasn't
+   reported leaves the two counts apart and rebuilds everything */
+static void refreshHierarchy(HierarchyGraph *graph) {
+    int count = graph->clustersWide * graph->clustersHigh;
+    if (graph->arena->passable_version - graph->version != graph->reported) {
+        buildAllClusters(graph);
+        return;
+    }
+    for (int cluster = 0; cluster < count && graph->dirtyCount > 0; cluster++) {
+        if (!graph->dirty[cluster]) continue;
+        buildCluster(graph, cluster);
+        graph->dirtyCount--;
+    }
+    graph->version = graph->arena->passable_version;
+    graph->reported = 0;
+}
+
+static int allocateClusters(HierarchyGraph *graph, Arena *arena) {
+    graph->arena = arena;
+    graph->clustersWide = (arena->width + CLUSTER_SIZE - 1) / CLUSTER_SIZE;
+    graph->clustersHigh = (arena->height + CLUSTER_SIZE - 1) / CLUSTER_SIZE;
+    size_t count = (size_t)graph->clustersWide * graph->clustersHigh;
+    graph->clusters = malloc(count * sizeof(Cluster));
+    graph->dirty = calloc(count, 1);
+    return graph->clusters != NULL && graph->dirty != NULL &&
+           initWorkspaceNodes(&graph->search, arena, count * MAX_CLUSTER_NODES + 2);
+}
+
+static HierarchyGraph *createHierarchy(Arena *arena) {
+    HierarchyGraph *graph = malloc(sizeof(HierarchyGraph));
+    if (graph == NULL) return NULL;
+    if (allocateClusters(graph, arena)) {
+        buildAllClusters(graph);
+        return graph;
+    }
+    free(graph->clusters);
+    free(graph->dirty);
+    free(graph);
+    return NULL;
+}
+
+void freeHierarchy(HierarchyGraph *graph) {
+    if (graph == NULL) return;
+    freePathWorkspace(&graph->search);
+    free(graph->clusters);
+    free(graph->dirty);
+    free(graph);
+}
+
+static void markClusterDirty(HierarchyGraph *graph, int x, int y) {
+    if (x < 0 || y < 0 || x >= graph->arena->width || y >= graph->arena->height) return;
+    int cluster = clusterOf(graph, y * graph->arena->width + x);
+    graph->dirtyCount += !graph->dirty[cluster];
+    graph->dirty[cluster] = 1;
+}
+
+/* A border tile also changes the entrances of the cluster across it */
+void invalidatePathTile(PathWorkspace *workspace, int x, int y) {
+    HierarchyGraph *graph = workspace->hierarchy;
+    if (graph == NULL) return;
+    markClusterDirty(graph, x, y);
+    if (x % CLUSTER_SIZE == 0) markClusterDirty(graph, x - 1, y);
+    if (x % CLUSTER_SIZE == CLUSTER_SIZE - 1) markClusterDirty(graph, x + 1, y);
+    if (y % CLUSTER_SIZE == 0) markClusterDirty(graph, x, y - 1);
+    if (y % CLUSTER_SIZE == CLUSTER_SIZE - 1) markClusterDirty(graph, x, y + 1);
+    graph->reported++;
+}
+
+static int nodeTile(HierarchyQuery *query, int node) {
+    if (node == query->startNode) return query->startTile;
+    if (node == query->goalNode) return query->goalTile;
+    return query->graph->clusters[node / MAX_CLUSTER_NODES].tiles[node % MAX_CLUSTER_NODES];
+}
+
+/* Every abstract edge is at least as long as the Manhattan distance it
+   spans, so the estimate stays consistent */
+static int hierarchyEstimate(AStarSearch *search, int node) {
+    HierarchyQuery *query = search->context;
+    int tile = nodeTile(query, node), width = search->arena->width;
+    return abs(tile % width - search->endX) + abs(tile / width - search->endY);
+}
+
+static int reachedHierarchyGoal(AStarSearch *search, int node) {
+    HierarchyQuery *query = search->context;
+    return node == query->goalNode;
+}
+
+static void expandStart(AStarSearch *search, HierarchyQuery *query) {
+    int first = query->startCluster * MAX_CLUSTER_NODES;
+    int count = query->graph->clusters[query->startCluster].count;
+    for (int i = 0; i < count; i++) {
+        if (query->startDistance[i] >= 0) relaxSuccessor(search, query->startNode, first + i, query->startDistance[i]);
+    }
+    if (query->direct >= 0) relaxSuccessor(search, query->startNode, query->goalNode, query->direct);
+}
+
+/* The other nodes of node's cluster, at their cached distances */
+static void expandInsideCluster(AStarSearch *search, Cluster *nodes, int node) {
+    int first = node - node % MAX_CLUSTER_NODES, index = node % MAX_CLUSTER_NODES;
+    for (int j = 0; j < nodes->count; j++) {
+        int distance = nodes->distance[index][j];
+        if (j != index && distance != NO_DISTANCE) relaxSuccessor(search, node, first + j, distance);
+    }
+}
+
+/* The nodes one step over a border from node */
+static void expandAcross(AStarSearch *search, HierarchyGraph *graph, Cluster *nodes, int node) {
+    int index = node % MAX_CLUSTER_NODES;
+    for (int k = 0; k < 2 && nodes->across[index][k] >= 0; k++) {
+        int across = findNode(graph, nodes->across[index][k]);
+        if (across >= 0) relaxSuccessor(search, node, across, 1);
+    }
+}
+
+static void expandHierarchy(AStarSearch *search, int node) {
+    HierarchyQuery *query = search->context;
+    if (node == query->startNode) {
+        expandStart(search, query);
+        return;
+    }
+    int cluster = node / MAX_CLUSTER_NODES, index = node % MAX_CLUSTER_NODES;
+    Cluster *nodes = &query->graph->clusters[cluster];
+    expandInsideCluster(search, nodes, node);
+    expandAcross(search, query->graph, nodes, node);
+    if (cluster == query->goalCluster && query->goalDistance[index] >= 0) {
+        relaxSuccessor(search, node, query->goalNode, query->goalDistance[index]);
+    }
+}
+
+/* Distances inside tile's cluster from tile to each of its nodes */
+static void linkQueryTile(HierarchyQuery *query, int tile, int distances[MAX_CLUSTER_NODES]) {
+    HierarchyGraph *graph = query->graph;
+    int cluster = clusterOf(graph, tile), bounds[4];
+    clusterBounds(graph, cluster, bounds);
+    searchCluster(graph, bounds, tile, -1, &query->expanded);
+    for (int i = 0; i < graph->clusters[cluster].count; i++) {
+        distances[i] = distanceTo(graph, bounds, graph->clusters[cluster].tiles[i]);
+    }
+}
+
+static void linkQuery(HierarchyQuery *query) {
+    HierarchyGraph *graph = query->graph;
+    int count = graph->clustersWide * graph->clustersHigh;
+    query->startNode = count * MAX_CLUSTER_NODES;
+    query->goalNode = query->startNode + 1;
+    query->startCluster = clusterOf(graph, query->startTile);
+    query->goalCluster = clusterOf(graph, query->goalTile);
+    linkQueryTile(query, query->goalTile, query->goalDistance);
+    query->direct = -1;
+    if (query->startCluster == query->goalCluster) {
+        int bounds[4];
+        clusterBounds(graph, query->goalCluster, bounds);
+        query->direct = distanceTo(graph, bounds, query->startTile);
+    }
+    linkQueryTile(query, query->startTile, query->startDistance);
+}
+
+/* Moves (x, y) to the neighbour one step nearer the last searchCluster's
+   origin */
+static void stepDown(HierarchyGraph *graph, const int bounds[4], int *x, int *y) {
+    int i = 0, next = graph->distance[localIndex(bounds, *x, *y)] - 1;
+    while (!isInside(bounds, *x + DIRECTION_DX[i], *y + DIRECTION_DY[i]) ||
+           graph->distance[localIndex(bounds, *x + DIRECTION_DX[i], *y + DIRECTION_DY[i])] != next) i++;
+    *x += DIRECTION_DX[i];
+    *y += DIRECTION_DY[i];
+}
+
+/* Writes the tiles after from up to to into path from slot on. An edge
+   over a border is one step; any other stays inside one cluster, so it
+   follows that cluster's distances from to back down */
+static void refineEdge(HierarchyQuery *query, int from, int to, int slot, Path *path) {
+    HierarchyGraph *graph = query->graph;
+    int width = graph->arena->width, bounds[4];
+    if (clusterOf(graph, from) != clusterOf(graph, to)) {
+        path->x[slot] = to % width;
+        path->y[slot] = to / width;
+        return;
+    }
+    clusterBounds(graph, clusterOf(graph, to), bounds);
+    searchCluster(graph, bounds, to, from, &query->expanded);
+    for (int x = from % width, y = from / width; x != to % width || y != to / width; slot++) {
+        stepDown(graph, bounds, &x, &y);
+        path->x[slot] = x;
+        path->y[slot] = y;
+    }
+}
+
+/* A node's cost is the length of the path up to its tile, so each edge
+   fills its own stretch of the path */
+static int refinePath(HierarchyQuery *query, AStarSearch *search, Path *path) {
+    int length = search->cost[query->goalNode];
+    if (length > path->capacity) return 0;
+    for (int node = query->goalNode; search->parent[node] != node; node = search->parent[node]) {
+        int parent = search->parent[node];
+        refineEdge(query, nodeTile(query, parent), nodeTile(query, node), search->cost[parent], path);
+    }
+    path->length = length;
+    return 1;
+}
+
+int prepareHierarchy(PathWorkspace *workspace) {
+    if (workspace->hierarchy == NULL) workspace->hierarchy = createHierarchy(workspace->arena);
+    if (workspace->hierarchy != NULL) refreshHierarchy(workspace->hierarchy);
+    return workspace->hierarchy != NULL;
+}
+
+static void initHierarchySearch(AStarSearch *search, HierarchyQuery *query, int endX, int endY) {
+    initAStar(search, &query->graph->search, endX, endY);
+    search->expand = expandHierarchy;
+    search->estimate = hierarchyEstimate;
+    search->reached = reachedHierarchyGoal;
+    search->context = query;
+    addSearchStart(search, query->startNode);
+}
+
+/* Builds the graph itself if preparePathSearch hasn't */
+int findPathHierarchical(PathWorkspace *workspace, int startX, int startY,
+                         int endX, int endY, Path *path) {
+    int width = workspace->arena->width, found = 0;
+    if (!prepareHierarchy(workspace)) return 0;
+    HierarchyGraph *graph = workspace->hierarchy;
+    HierarchyQuery query = {graph, startY * width + startX, endY * width + endX};
+    AStarSearch search;
+    linkQuery(&query);
+    initHierarchySearch(&search, &query, endX, endY);
+    if (astarSearch(&search) >= 0) found = refinePath(&query, &search, path);
+    path->expanded = search.expanded + query.expanded;
+    return found;
+}
@@ -0,0 +1,109 @@
+#include <stdlib.h>
+#include "pathsearch.h"
+
+/* Jump Point Search adapted to 4-connected moves. Canonical paths may turn
+   from vertical to horizontal anywhere but from horizontal to vertical only
+   where the obstacle beside the row ends (a forced neighbour), so vertical
+   jumps scan sideways at every step and only jump points enter the heap */
+
+static int sign(int value) {
+    return (value > 0) - (value < 0);
+}
+
+static int distance(int width, int from, int to) {
+    return abs(from % width - to % width) + abs(from / width - to / width);
+}
+
+static int isGoal(AStarSearch *search, int x, int y) {
+    return x == search->endX && y == search->endY;
+}
+
+static int hasForcedTurn(Arena *arena, int x, int y, int dx) {
+    return (isPassable(arena, x, y - 1) && !isPassable(arena, x - dx, y - 1)) ||
+           (isPassable(arena, x, y + 1) && !isPassable(arena, x - dx, y + 1));
+}
+
+static int jumpHorizontal(AStarSearch *search, int x, int y, int dx) {
+    Arena *arena = search->arena;
+    for (;;) {
+        x += dx;
+        if (!isPassable(arena, x, y)) return -1;
+        if (isGoal(search, x, y) || hasForcedTurn(arena, x, y, dx)) return y * arena->width + x;
+    }
+}
+
+static int jumpVertical(AStarSearch *search, int x, int y, int dy) {
+    Arena *arena = search->arena;
+    for (;;) {
+        y += dy;
+        if (!isPassable(arena, x, y)) return -1;
+        if (isGoal(search, x, y) || jumpHorizontal(search, x, y, 1) >= 0 ||
+            jumpHorizontal(search, x, y, -1) >= 0) {
+            return y * arena->width + x;
+        }
+    }
+}
+
+static int isCanonicalStep(Arena *arena, int x, int y, int dx, int dy, int stepX, int stepY) {
+    if (dx == 0 && dy == 0) return 1;
+    if (stepX == -dx && stepY == -dy) return 0;
+    if (dx == 0 || stepY == 0) return 1;
+    return isPassable(arena, x, y + stepY) && !isPassable(arena, x - dx, y + stepY);
+}
+
+static void expandJumpPoint(AStarSearch *search, int tile) {
+    int width = search->arena->width;
+    int x = tile % width, y = tile / width;
+    int dx = sign(x - search->parent[tile] % width);
+    int dy = sign(y - search->parent[tile] / width);
+    for (int i = 0; i < 4; i++) {
+        int stepX = DIRECTION_DX[i], stepY = DIRECTION_DY[i];
+        if (!isCanonicalStep(search->arena, x, y, dx, dy, stepX, stepY)) continue;
+        int jump = stepY == 0 ? jumpHorizontal(search, x, y, stepX)
+                              : jumpVertical(search, x, y, stepY);
+        if (jump >= 0) relaxSuccessor(search, tile, jump, distance(width, tile, jump));
+    }
+}
+
+static int fillSegment(Path *path, int width, int to, int from, int slot) {
+    int x = to % width, y = to / width;
+    int stepX = sign(from % width - x), stepY = sign(from / width - y);
+    while (x != from % width || y != from / width) {
+        slot--;
+        path->x[slot] = x;
+        path->y[slot] = y;
+        x += stepX;
+        y += stepY;
+    }
+    return slot;
+}
+
+/* Jump points are joined by straight runs, filled in tile by tile */
+static int buildJumpPath(AStarSearch *search, int start, int end, Path *path) {
+    int width = search->arena->width;
+    int len = 0;
+    for (int tile = end; tile != start; tile = search->parent[tile]) {
+        len += distance(width, tile, search->parent[tile]);
+    }
+    if (len > path->capacity) return 0;
+    path->length = len;
+    for (int tile = end; tile != start; tile = search->parent[tile]) {
+        len = fillSegment(path, width, tile, search->parent[tile], len);
+    }
+    return 1;
+}
+
+int findPathJumpPoint(PathWorkspace *workspace, int startX, int startY,
+                      int endX, int endY, Path *path) {
+    AStarSearch search;
+    Arena *arena = workspace->arena;
+    int found = 0;
+    initAStar(&search, workspace, endX, endY);
+
+    search.expand = expandJumpPoint;
+    int start = startY * arena->width + startX;
+    addSearchStart(&search, start);
+    if (astarSearch(&search) >= 0) found = buildJumpPath(&search, start, search.end, path);
+    path->expanded = search.expanded;
+    return found;
+}
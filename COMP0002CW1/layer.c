@@ -0,0 +1,93 @@
+#include <stdlib.h>
+#include "layer.h"
+
+extern const int TILE_SIZE;
+
+typedef struct {
+    Arena *arena;
+    int tileType;
+    unsigned char *merged;
+} MergeState;
+
+/* Interior tile outlines overlap, so the whole grid is one line per row and column edge */
+static void drawGridLines(Arena *arena) {
+    int right = (arena->width - 1) * TILE_SIZE;
+    int bottom = (arena->height - 1) * TILE_SIZE;
+    setColour(lightgray);
+    for (int y = 1; y < arena->height; y++) {
+        drawLine(TILE_SIZE, y * TILE_SIZE, right, y * TILE_SIZE);
+    }
+    for (int x = 1; x < arena->width; x++) {
+        drawLine(x * TILE_SIZE, TILE_SIZE, x * TILE_SIZE, bottom);
+    }
+}
+
+static int isMergeable(MergeState *state, int x, int y) {
+    return !state->merged[y * state->arena->width + x] &&
+           getTile(state->arena, x, y) == state->tileType;
+}
+
+static int runWidth(MergeState *state, int x, int y) {
+    int width = 0;
+    while (x + width < state->arena->width && isMergeable(state, x + width, y)) {
+        width++;
+    }
+    return width;
+}
+
+static int rowMatches(MergeState *state, int x, int y, int width) {
+    for (int i = 0; i < width; i++) {
+        if (!isMergeable(state, x + i, y)) return 0;
+    }
+    return 1;
+}
+
+static void mergeRectangle(MergeState *state, int x, int y) {
+    int width = runWidth(state, x, y);
+    int height = 1;
+    while (y + height < state->arena->height && rowMatches(state, x, y + height, width)) {
+        height++;
+    }
+    for (int row = y; row < y + height; row++) {
+        for (int i = 0; i < width; i++) state->merged[row * state->arena->width + x + i] = 1;
+    }
+    fillRect(x*TILE_SIZE, y*TILE_SIZE, width*TILE_SIZE, height*TILE_SIZE);
+}
+
+/* Greedy cover: each unmerged tile starts the widest run, grown downwards */
+static void fillMergedTiles(Arena *arena, int tileType, colour c) {
+    MergeState state = {arena, tileType, calloc((size_t)arena->width * arena->height, 1)};
+    if (state.merged == NULL) return;
+    setColour(c);
+    for (int y = 0; y < arena->height; y++) {
+        for (int x = 0; x < arena->width; x++) {
+            if (isMergeable(&state, x, y)) mergeRectangle(&state, x, y);
+        }
+    }
+    free(state.merged);
+}
+
+static void drawStaticTiles(Arena *arena) {
+    drawGridLines(arena);
+    fillMergedTiles(arena, WALL, red);
+    fillMergedTiles(arena, OBSTACLE, black);
+}
+
+void buildStaticLayer(StaticLayer *layer, Arena *arena) {
+    beginCommandBlock(&layer->commands);
+    drawStaticTiles(arena);
+    layer->recorded = endCommandBlock();
+}
+
+/* A layer whose block ran out of memory is drawn afresh each time */
+void drawBackground(Arena *arena, StaticLayer *layer) {
+    background();
+    clear();
+    if (layer->recorded) drawCommandBlock(&layer->commands);
+    else drawStaticTiles(arena);
+    drawMarkers(arena);
+}
+
+void freeStaticLayer(StaticLayer *layer) {
+    freeCommandBlock(&layer->commands);
+}
@@ -0,0 +1,19 @@
+#ifndef LAYER_H
+#define LAYER_H
+
+#include "arena.h"
+#include "graphics.h"
+
+/* Grid lines, walls and obstacles never change after setupGame, so they are
+   drawn once into a cached command block. recorded is 0 if the block ran
+   out of memory */
+typedef struct {
+    CommandBlock commands;
+    int recorded;
+} StaticLayer;
+
+void buildStaticLayer(StaticLayer *layer, Arena *arena);
+void drawBackground(Arena *arena, StaticLayer *layer);
+void freeStaticLayer(StaticLayer *layer);
+
+#endif
@@ -1,68 +1,648 @@
+#include <pthread.h>
+#include <stddef.h>
+#include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <time.h>
 #include "arena.h"
+#include "arenafile.h"
+#include "bench.h"
+#include "coverage.h"
+#include "frontier.h"
 #include "graphics.h"
+#include "layer.h"
 #include "pathfinding.h"
+#include "profile.h"
+#include "render.h"
+#include "runner.h"
+#include "team.h"
+#include "tour.h"
+#include "trace.h"
 
 #define ANIMATION_DELAY 150
 #define MAX_MOVES 1000
+#define RANDOM_SHAPE -1
 
 const int TILE_SIZE = 20;
 
-static MovementTrail g_trail;
+/* How the robot looks for markers */
+typedef enum {
+    PLAN_EXPLORE,
+    PLAN_TOUR,
+    PLAN_COVERAGE
+} CollectionPlan;
+
+/* Zero width/height picks a random size, as in interactive runs */
+typedef struct {
+    int headless;
+    int benchmark;
+    int seeded;
+    unsigned int firstSeed;
+    unsigned int lastSeed;
+    int width;
+    int height;
+    int shape;
+    int markers;
+    CollectionPlan plan;
+    PathAlgorithm pathAlgorithm;
+    PathAlgorithm benchAlgorithm;
+    int moveCost;
+    int turnCost;
+    int robots;
+    int jobs;
+    const char *saveArenas;
+    const char *loadArenas;
+    const char *trace;
+    const char *replay;
+    const char *profile;
+    int fromStep;
+    RenderSettings render;
+} SimulationConfig;
+
+/* Batch context for runs over arenas selected from a corpus */
+typedef struct {
+    const SimulationConfig *config;
+    const ArenaRecord *arenas;
+} CorpusRun;
+
+/* A team frame runs on a team thread, so it reaches the run's view and
+   trace through here rather than the thread-local globals */
+typedef struct {
+    TeamView view;
+    Trace *trace;
+    FrameGate *gate;
+} TeamFrameContext;
+
+/* Per-run state is thread-local so parallel batch workers never share it;
+   the settings below are written once before any run starts */
+static _Thread_local MovementTrail g_trail;
+static _Thread_local DirtyTiles g_dirty;
+static _Thread_local StaticLayer g_layer;
+static _Thread_local RunStats g_stats;
+static _Thread_local int g_ticks;
+static _Thread_local Trace g_trace;
+static _Thread_local FrameGate g_frames;
+static FILE *g_traceFile;
+static pthread_mutex_t g_traceLock = PTHREAD_MUTEX_INITIALIZER;
+static int g_robots;
+static int g_headless;
+static CollectionPlan g_plan;
+static PathAlgorithm g_pathAlgorithm;
+static int g_moveCost;
+static int g_turnCost;
+static RenderSettings g_render;
 
 typedef struct {
     Robot *robot;
     Arena *arena;
-    int (*visited)[MAX_ARENA_SIZE];
+    uint64_t *visited;
+    FrontierSet frontier;
+    Path path;
+    PathWorkspace workspace;
 } ExplorationContext;
 
-void setupGame(Arena *arena);
-void runSimulation(Robot *robot, Arena *arena);
-void followPath(Robot *robot, Arena *arena, Path *path);
+int setupGame(Arena *arena, const SimulationConfig *config, const ArenaRecord *loaded,
+              ShapeType *shape);
+void runSimulation(Robot *robots, Arena *arena);
 void exploreAndCollect(Robot *robot, Arena *arena);
-void deliverToCorner(Robot *robot, Arena *arena);
+void collectByTour(Robot *robot, Arena *arena);
+void collectByCoverage(Robot *robot, Arena *arena);
+void exploreWithTeam(Robot *robots, Arena *arena);
 
-int main(int argc, char **argv) {
+static int isValidArenaSize(int size) {
+    return size >= MIN_ARENA_SIZE && size <= MAX_ARENA_DIMENSION;
+}
+
+static int parseSeedRange(const char *value, void *field) {
+    SimulationConfig *config = field;
+    int fields = sscanf(value, "%u-%u", &config->firstSeed, &config->lastSeed);
+    if (fields == 1) config->lastSeed = config->firstSeed;
+    config->seeded = 1;
+    return fields >= 1 && config->lastSeed >= config->firstSeed;
+}
+
+static int parseSize(const char *value, void *field) {
+    SimulationConfig *config = field;
+    int fields = sscanf(value, "%dx%d", &config->width, &config->height);
+    if (fields == 1) config->height = config->width;
+    return fields >= 1 && isValidArenaSize(config->width) && isValidArenaSize(config->height);
+}
+
+static int parseShape(const char *value, void *field) {
+    int *shape = field;
+    *shape = RANDOM_SHAPE;
+    for (int i = 0; i < SHAPE_COUNT; i++) {
+        if (strcmp(value, shapeName(i)) == 0) *shape = i;
+    }
+    return *shape != RANDOM_SHAPE || strcmp(value, "random") == 0;
+}
+
+static int parsePathAlgorithm(const char *value, void *field) {
+    PathAlgorithm *algorithm = field;
+    for (int i = 0; i < PATH_ALGORITHM_COUNT; i++) {
+        if (strcmp(value, pathAlgorithmName(i)) == 0) {
+            *algorithm = i;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/* Marker count, and the weights of a forward step and a quarter turn for
+   --path heading */
+static int parsePositive(const char *value, void *field) {
+    int *number = field;
+    return sscanf(value, "%d", number) == 1 && *number > 0;
+}
+
+/* "explore" searches for markers; "tour" collects them on a route planned
+   from the full map; "coverage" sweeps the map's boustrophedon cells */
+static int parsePlan(const char *value, void *field) {
+    static const char *names[] = {"explore", "tour", "coverage"};
+    CollectionPlan *plan = field;
+    for (int i = 0; i <= PLAN_COVERAGE; i++) {
+        if (strcmp(value, names[i]) == 0) {
+            *plan = i;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static int parseRobotCount(const char *value, void *field) {
+    return parsePositive(value, field) && *(int *)field <= MAX_TEAM_SIZE;
+}
+
+/* Replay position and frame delay */
+static int parseNonNegative(const char *value, void *field) {
+    int *number = field;
+    return sscanf(value, "%d", number) == 1 && *number >= 0;
+}
+
+/* Worker threads for --batch */
+static int parseJobCount(const char *value, void *field) {
+    return parsePositive(value, field) && *(int *)field <= MAX_JOBS;
+}
+
+/* "all", "every:N" (every Nth frame), "events" (marker pickups and jump
+   ends) or "final" */
+static int parseRenderMode(const char *value, void *field) {
+    static const char *names[] = {"all", "every", "events", "final"};
+    RenderSettings *render = field;
+    for (int i = 0; i <= RENDER_FINAL; i++) {
+        if (strcmp(value, names[i]) == 0 && i != RENDER_EVERY) {
+            render->mode = i;
+            return 1;
+        }
+    }
+    render->mode = RENDER_EVERY;
+    return sscanf(value, "every:%d", &render->every) == 1 && render->every > 0;
+}
+
+static int parseBenchmark(const char *value, void *field) {
+    SimulationConfig *config = field;
+    config->benchmark = 1;
+    return parsePathAlgorithm(value, &config->benchAlgorithm);
+}
+
+/* File names are kept as given */
+static int parseFileName(const char *value, void *field) {
+    *(const char **)field = value;
+    return 1;
+}
+
+/* Each option's value is parsed into the config member at offset; the
+   parsers that set several members get the whole config (offset 0) */
+typedef struct {
+    const char *name;
+    int (*parse)(const char *value, void *field);
+    size_t offset;
+} CommandOption;
+
+#define OPTION_COUNT 19
+
+static const CommandOption OPTIONS[OPTION_COUNT] = {
+    {"--seeds", parseSeedRange, 0},
+    {"--size", parseSize, 0},
+    {"--shape", parseShape, offsetof(SimulationConfig, shape)},
+    {"--path", parsePathAlgorithm, offsetof(SimulationConfig, pathAlgorithm)},
+    {"--bench", parseBenchmark, 0},
+    {"--markers", parsePositive, offsetof(SimulationConfig, markers)},
+    {"--plan", parsePlan, offsetof(SimulationConfig, plan)},
+    {"--move-cost", parsePositive, offsetof(SimulationConfig, moveCost)},
+    {"--turn-cost", parsePositive, offsetof(SimulationConfig, turnCost)},
+    {"--robots", parseRobotCount, offsetof(SimulationConfig, robots)},
+    {"--jobs", parseJobCount, offsetof(SimulationConfig, jobs)},
+    {"--save-arenas", parseFileName, offsetof(SimulationConfig, saveArenas)},
+    {"--load-arenas", parseFileName, offsetof(SimulationConfig, loadArenas)},
+    {"--trace", parseFileName, offsetof(SimulationConfig, trace)},
+    {"--replay", parseFileName, offsetof(SimulationConfig, replay)},
+    {"--from-step", parseNonNegative, offsetof(SimulationConfig, fromStep)},
+    {"--delay", parseNonNegative, offsetof(SimulationConfig, render.delay)},
+    {"--render", parseRenderMode, offsetof(SimulationConfig, render)},
+    {"--profile", parseFileName, offsetof(SimulationConfig, profile)}
+};
+
+static int parseOption(const char *name, const char *value, SimulationConfig *config) {
+    for (int i = 0; i < OPTION_COUNT; i++) {
+        if (strcmp(name, OPTIONS[i].name) == 0) {
+            return OPTIONS[i].parse(value, (char *)config + OPTIONS[i].offset);
+        }
+    }
+    return 0;
+}
+
+static int parseArguments(int argc, char **argv, SimulationConfig *config) {
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--batch") == 0) {
+            config->headless = 1;
+        } else if (i + 1 >= argc || !parseOption(argv[i], argv[i + 1], config)) {
+            return 0;
+        } else {
+            i++;
+        }
+    }
+    return 1;
+}
+
+static void printUsage(const char *program) {
+    fprintf(stderr, "usage: %s [--batch] [--jobs N] [--seeds FIRST[-LAST]] [--size W[xH]]"
+                    " [--shape circle|diamond|rectangle|oval|triangle|random]"
+                    " [--markers N] [--robots K] [--plan explore|tour|coverage]"
+                    " [--path bfs|astar|jps|field|heading|bidir|hpa] [--move-cost N] [--turn-cost N]"
+                    " [--bench astar|jps|field|heading|bidir|hpa] [--save-arenas FILE] [--load-arenas FILE]"
+                    " [--trace FILE] [--replay FILE [--from-step N]]"
+                    " [--render all|every:N|events|final] [--delay MS] [--profile FILE]\n", program);
+}
+
+static void printRunResult(const RunRecord *run) {
+    const RunStats *stats = &run->stats;
+    double revisitedPct = stats->steps > 0 ? 100.0 * stats->revisits / stats->steps : 0.0;
+    if (!run->ok) {
+        fprintf(stderr, "seed=%u: out of memory\n", run->seed);
+        return;
+    }
+    printf("seed=%u shape=%s width=%d height=%d robots=%d ticks=%d steps=%d revisited_pct=%.1f"
+           " turns=%d jumps=%d searches=%d expanded=%ld markers_left=%d time_ms=%.3f\n",
+           run->seed, shapeName(run->shape), run->width, run->height, g_robots, run->ticks,
+           stats->steps, revisitedPct, stats->turns, stats->jumps, stats->pathSearches,
+           stats->nodesExpanded, run->markersLeft, run->elapsedMs);
+}
+
+static void releaseGame(Arena *arena) {
+    freeArena(arena);
+    freeMovementTrail(&g_trail);
+    freeDirtyTiles(&g_dirty);
+}
+
+static void initRobots(Robot *robots, Arena *arena) {
+    for (int i = 0; i < g_robots; i++) {
+        initRobot(&robots[i], arena);
+    }
+}
+
+/* With --trace, the run's moves are appended to the trace file; runs on
+   different batch workers take turns writing */
+static void runAndTrace(Robot *robots, Arena *arena, const ArenaInfo *info) {
+    int traced = g_traceFile != NULL && initTrace(&g_trace, arena, robots, g_robots);
+    runSimulation(robots, arena);
+    if (traced) {
+        pthread_mutex_lock(&g_traceLock);
+        traced = writeTrace(g_traceFile, &g_trace, arena, info);
+        pthread_mutex_unlock(&g_traceLock);
+    }
+    if (g_traceFile != NULL && !traced) fprintf(stderr, "seed=%u: trace not written\n", info->seed);
+    freeTrace(&g_trace);
+}
+
+/* Runs a set-up arena and fills in its result */
+static void recordGame(Arena *arena, ShapeType shape, unsigned int seed, RunRecord *record) {
+    Robot robots[MAX_TEAM_SIZE];
+    ArenaInfo info = {shape, seed, saveRandomState()};
+    initRobots(robots, arena);
+    g_stats = (RunStats){0};
+    double start = currentTimeMs();
+    runAndTrace(robots, arena, &info);
+    double elapsedMs = currentTimeMs() - start;
+    *record = (RunRecord){seed, 1, shape, arena->width, arena->height, g_ticks,
+                          countMarkers(arena), g_stats, elapsedMs};
+}
+
+/* Generates the seed's arena, or takes loaded, then runs it */
+static void runGame(const SimulationConfig *config, unsigned int seed, const ArenaRecord *loaded,
+                    RunRecord *record) {
+    Arena arena;
+    ShapeType shape;
+
+    seedRandom(seed);
+    *record = (RunRecord){.seed = seed};
+    if (setupGame(&arena, config, loaded, &shape)) recordGame(&arena, shape, seed, record);
+    releaseGame(&arena);
+}
+
+/* A SeedJob; runs on whichever batch worker took the seed */
+static void runSeed(void *context, unsigned int seed, RunRecord *record) {
+    runGame(context, seed, NULL, record);
+}
+
+/* A SeedJob whose "seed" indexes the selected corpus arenas */
+static void runCorpusArena(void *context, unsigned int index, RunRecord *record) {
+    const CorpusRun *run = context;
+    runGame(run->config, run->arenas[index].header->seed, &run->arenas[index], record);
+}
+
+/* Headless: no drawapp commands. Jobs first..last run on config->jobs
+   threads; the result lines come out in order, then one summary line */
+static void runBatch(const SimulationConfig *config, SeedJob job, void *context,
+                     unsigned int first, unsigned int last) {
+    size_t count = (size_t)(last - first) + 1;
+    RunRecord *records = malloc(count * sizeof(RunRecord));
+    g_headless = 1;
+    if (records == NULL) {
+        fprintf(stderr, "batch: out of memory\n");
+        return;
+    }
+    double start = currentTimeMs();
+    runSeedsParallel(first, last, config->jobs, job, context, records);
+    double wallMs = currentTimeMs() - start;
+    for (size_t i = 0; i < count; i++) printRunResult(&records[i]);
+    printRunSummary(records, count, wallMs);
+    free(records);
+}
+
+static void runInteractive(const SimulationConfig *config, const ArenaRecord *loaded) {
+    Arena arena;
+    Robot robots[MAX_TEAM_SIZE];
+    ShapeType shape;
+
+    unsigned int seed = config->seeded ? config->firstSeed : (unsigned int)time(NULL);
+    seedRandom(seed);
+    if (setupGame(&arena, config, loaded, &shape)) {
+        ArenaInfo info = {shape, loaded != NULL ? loaded->header->seed : seed, saveRandomState()};
+        initRobots(robots, &arena);
+        runAndTrace(robots, &arena, &info);
+    }
+    releaseGame(&arena);
+}
+
+/* Generates the seed's arena exactly as runSeed does and appends it to file */
+static int saveArena(FILE *file, const SimulationConfig *config, unsigned int seed) {
+    Arena arena;
+    ShapeType shape;
+    int saved = 0;
+    seedRandom(seed);
+    if (setupGame(&arena, config, NULL, &shape)) {
+        ArenaInfo info = {shape, seed, saveRandomState()};
+        saved = writeArena(file, &arena, &info);
+    }
+    releaseGame(&arena);
+    return saved;
+}
+
+/* Writes the arena each seed would run on */
+static void saveArenas(const SimulationConfig *config) {
+    FILE *file = fopen(config->saveArenas, "wb");
+    unsigned int seed = config->firstSeed, saved = 0;
+    g_headless = 1;
+    if (file == NULL) {
+        perror(config->saveArenas);
+        return;
+    }
+    do {
+        saved += saveArena(file, config, seed);
+    } while (seed++ != config->lastSeed);
+    if (fclose(file) != 0) saved = 0;
+    printf("saved %u arenas to %s\n", saved, config->saveArenas);
+}
+
+/* The arenas whose seed is in the --seeds range, or every one without it */
+static int selectCorpusArenas(const ArenaCorpus *corpus, const SimulationConfig *config,
+                              ArenaRecord *arenas) {
+    size_t offset = 0;
+    int count = 0;
+    while (nextCorpusArena(corpus, &offset, &arenas[count])) {
+        unsigned int seed = arenas[count].header->seed;
+        if (!config->seeded || (seed >= config->firstSeed && seed <= config->lastSeed)) count++;
+    }
+    return count;
+}
+
+static void runCorpusArenas(const SimulationConfig *config, const ArenaRecord *arenas, int count) {
+    CorpusRun run = {config, arenas};
+    if (count == 0) {
+        fprintf(stderr, "%s: no arenas selected\n", config->loadArenas);
+    } else if (config->benchmark) {
+        runCorpusBenchmark(config->benchAlgorithm, arenas, count);
+    } else if (config->headless) {
+        runBatch(config, runCorpusArena, &run, 0, (unsigned int)count - 1);
+    } else {
+        runInteractive(config, &arenas[0]);
+    }
+}
+
+/* The corpus stays mapped while it runs; only the arenas themselves are copied */
+static void runFromCorpus(const SimulationConfig *config) {
+    ArenaCorpus corpus;
+    if (!openArenaCorpus(config->loadArenas, &corpus)) {
+        fprintf(stderr, "%s: not a readable arena file\n", config->loadArenas);
+        return;
+    }
+    ArenaRecord *arenas = malloc((corpus.count + 1) * sizeof(ArenaRecord));
+    if (arenas != NULL) runCorpusArenas(config, arenas, selectCorpusArenas(&corpus, config, arenas));
+    free(arenas);
+    closeArenaCorpus(&corpus);
+}
+
+/* The first trace in the file, or the first whose seed is in --seeds */
+static int findTrace(FILE *file, const SimulationConfig *config, Trace *trace, Arena *arena) {
+    ArenaInfo info;
+    while (readTrace(file, trace, arena, &info)) {
+        if (!config->seeded || (info.seed >= config->firstSeed && info.seed <= config->lastSeed)) return 1;
+        freeTrace(trace);
+        freeArena(arena);
+    }
+    return 0;
+}
+
+/* Reads the trace to replay into memory; the file is closed either way */
+static int loadReplay(const SimulationConfig *config, Trace *trace, Arena *arena) {
+    FILE *file = fopen(config->replay, "rb");
+    if (file == NULL) {
+        perror(config->replay);
+        return 0;
+    }
+    int found = findTrace(file, config, trace, arena);
+    if (!found) fprintf(stderr, "%s: no trace found\n", config->replay);
+    fclose(file);
+    return found;
+}
+
+/* Draws a recorded run without simulating it */
+static void runReplay(const SimulationConfig *config) {
+    Trace trace;
     Arena arena;
-    Robot robot;
+    if (!loadReplay(config, &trace, &arena)) return;
+    if (!replayTrace(&trace, &arena, config->fromStep, &config->render)) {
+        fprintf(stderr, "%s: bad trace\n", config->replay);
+    }
+    freeTrace(&trace);
+    freeArena(&arena);
+}
+
+/* Counters and phase times of the whole process, as JSON */
+static void writeProfile(const char *path) {
+#ifdef NO_PROFILE
+    fprintf(stderr, "%s: built with -DNO_PROFILE, nothing was recorded\n", path);
+#else
+    FILE *file = fopen(path, "w");
+    if (file == NULL || !writeProfileJson(file)) perror(path);
+    if (file != NULL) fclose(file);
+#endif
+}
 
-    srand(time(NULL));
-    setupGame(&arena);
-    initRobot(&robot, &arena);
-    runSimulation(&robot, &arena);
+static void run(const SimulationConfig *config) {
+    if (config->replay != NULL) {
+        runReplay(config);
+    } else if (config->loadArenas != NULL) {
+        runFromCorpus(config);
+    } else if (config->saveArenas != NULL) {
+        saveArenas(config);
+    } else if (config->benchmark) {
+        runPathBenchmark(config->benchAlgorithm, config->firstSeed, config->lastSeed,
+                         config->width, config->height);
+    } else if (config->headless) {
+        runBatch(config, runSeed, (void *)config, config->firstSeed, config->lastSeed);
+    } else {
+        runInteractive(config, NULL);
+    }
+}
 
+/* Settings every run reads, fixed before the first one starts, and the
+   --trace file; returns 0 if that can't be opened */
+static int applySettings(const SimulationConfig *config) {
+    g_pathAlgorithm = config->pathAlgorithm;
+    g_plan = config->plan;
+    g_robots = config->robots;
+    g_moveCost = config->moveCost;
+    g_turnCost = config->turnCost;
+    g_render = config->render;
+    if (config->trace != NULL && (g_traceFile = fopen(config->trace, "wb")) == NULL) {
+        perror(config->trace);
+        return 0;
+    }
+    return 1;
+}
+
+int main(int argc, char **argv) {
+    SimulationConfig config = {0, 0, 0, 1, 1, 0, 0, RANDOM_SHAPE, 0, PLAN_EXPLORE, PATH_BFS, PATH_BFS,
+                               1, 1, 1, 1, NULL, NULL, NULL, NULL, NULL, 0, {RENDER_ALL, 1, ANIMATION_DELAY}};
+
+    if (!parseArguments(argc, argv, &config)) {
+        printUsage(argv[0]);
+        return 1;
+    }
+    if (!applySettings(&config)) return 1;
+    run(&config);
+    if (config.profile != NULL) writeProfile(config.profile);
+    if (g_traceFile != NULL && fclose(g_traceFile) != 0) perror(config.trace);
     return 0;
 }
 
-void setupGame(Arena *arena) {
-    initArena(arena);
+static void drawArena(Arena *arena) {
+    if (g_headless) return;
+    PROFILE_TIMER(start);
     setWindowSize(arena->width * TILE_SIZE, arena->height * TILE_SIZE);
-    initMovementTrail(&g_trail);
-    int markerCount = 3 + rand() % 5;
-    int obstacleCount = arena->width / 6;
-    ShapeType shape = rand() % 5;
-    placeShapedObstacles(arena, shape);
-    placeRandomObstacles(arena, obstacleCount, shape);
-    placeMarkersInShape(arena, markerCount, shape);
-    drawBackground(arena);
+    freeStaticLayer(&g_layer);
+    buildStaticLayer(&g_layer, arena);
+    drawBackground(arena, &g_layer);
     foreground();
+    PROFILE_ELAPSED(PROFILE_RENDER, start);
+}
+
+/* Trails live on the background layer and only changed tiles are repainted;
+   the robot sits on the foreground layer, so leaving a tile dirties nothing */
+static void drawFrame(Robot *robot, Arena *arena) {
+    if (g_traceFile != NULL) recordTraceFrame(&g_trace, robot, 1);
+    if (g_headless || !passesFrameGate(&g_frames, arena)) return;
+    drawRobotFrame(&g_dirty, arena, &g_trail, robot, 1, g_render.delay);
+}
+
+/* Decimated rendering always ends on the run's final state */
+static void drawLastFrame(Robot *robots, Arena *arena) {
+    if (g_headless || !g_frames.skipped) return;
+    drawRobotFrame(&g_dirty, arena, &g_trail, robots, g_robots, g_render.delay);
+}
+
+/* Every buffer is allocated even on failure so releaseGame can free them all */
+static int allocateGame(Arena *arena, const SimulationConfig *config) {
+    int width = config->width ? config->width : randomArenaSize();
+    int height = config->height ? config->height : randomArenaSize();
+    int ok = initArena(arena, width, height);
+    ok &= initMovementTrail(&g_trail, width, height);
+    ok &= initDirtyTiles(&g_dirty, width, height);
+    return ok;
+}
+
+static int generateGame(Arena *arena, const SimulationConfig *config, ShapeType *shape) {
+    if (!allocateGame(arena, config)) return 0;
+    int markerCount = 3 + randomBelow(5);
+    if (config->markers > 0) markerCount = config->markers;
+    *shape = randomBelow(SHAPE_COUNT);
+    if (config->shape != RANDOM_SHAPE) *shape = config->shape;
+    populateArena(arena, *shape, markerCount);
+    return 1;
+}
+
+/* The generator resumes where the arena's own run was, so robots start in
+   the same places. Stops at the first failure; releaseGame frees whatever
+   was allocated */
+static int loadGame(Arena *arena, const ArenaRecord *loaded, ShapeType *shape) {
+    int width = (int)loaded->header->width, height = (int)loaded->header->height;
+    if (!loadCorpusArena(loaded, arena)) return 0;
+    *shape = loaded->header->shape;
+    restoreRandomState(loaded->header->randomState);
+    return initMovementTrail(&g_trail, width, height) && initDirtyTiles(&g_dirty, width, height);
 }
 
-void runSimulation(Robot *robot, Arena *arena) {
-    exploreAndCollect(robot, arena);
+/* loaded, when not NULL, replaces the generated arena */
+int setupGame(Arena *arena, const SimulationConfig *config, const ArenaRecord *loaded,
+              ShapeType *shape) {
+    PROFILE_TIMER(start);
+    int ok = loaded != NULL ? loadGame(arena, loaded, shape) : generateGame(arena, config, shape);
+    PROFILE_ELAPSED(PROFILE_GENERATE, start);
+    if (ok) drawArena(arena);
+    return ok;
+}
+
+/* A team always explores; a single robot takes one move per tick */
+void runSimulation(Robot *robots, Arena *arena) {
+    PROFILE_TIMER(start);
+    initFrameGate(&g_frames, &g_render, arena);
+    if (g_robots > 1) {
+        exploreWithTeam(robots, arena);
+    } else if (g_plan == PLAN_TOUR) {
+        collectByTour(robots, arena);
+    } else if (g_plan == PLAN_COVERAGE) {
+        collectByCoverage(robots, arena);
+    } else {
+        exploreAndCollect(robots, arena);
+    }
+    if (g_robots == 1) g_ticks = g_stats.steps;
+    drawLastFrame(robots, arena);
+    PROFILE_ELAPSED(PROFILE_EXPLORE, start);
 }
 
+/* visited shares the arena's bitplane layout, so open tiles are passable & ~visited */
 static int isUnvisited(ExplorationContext *ctx, int x, int y) {
-    if (x < 1 || x >= ctx->arena->width-1 || y < 1 || y >= ctx->arena->height-1) return 0;
-    if (ctx->visited[y][x]) return 0;
-    return (ctx->arena->grid[y][x] == EMPTY || ctx->arena->grid[y][x] == MARKER);
+    size_t word = tileWord(ctx->arena, x, y);
+    return (ctx->arena->passable[word] & ~ctx->visited[word] & tileMask(x)) != 0;
 }
 
-static int findAdjacentUnvisited(ExplorationContext *ctx, int *nextX, int *nextY) {
+static int findUnvisitedAround(ExplorationContext *ctx, int fromX, int fromY,
+                               int *nextX, int *nextY) {
     for (int i = 0; i < 4; i++) {
-        int x = ctx->robot->x + DIRECTION_DX[i];
-        int y = ctx->robot->y + DIRECTION_DY[i];
+        int x = fromX + DIRECTION_DX[i];
+        int y = fromY + DIRECTION_DY[i];
         if (isUnvisited(ctx, x, y)) {
             *nextX = x;
             *nextY = y;
@@ -72,166 +652,276 @@ static int findAdjacentUnvisited(ExplorationContext *ctx, int *nextX, int *nextY
     return 0;
 }
 
-static char getDirection(int fromX, int fromY, int toX, int toY) {
-    if (toX > fromX) return 'E';
-    if (toX < fromX) return 'W';
-    if (toY > fromY) return 'S';
-    return 'N';
+static int findAdjacentUnvisited(ExplorationContext *ctx, int *nextX, int *nextY) {
+    return findUnvisitedAround(ctx, ctx->robot->x, ctx->robot->y, nextX, nextY);
+}
+
+static int bordersUnvisited(ExplorationContext *ctx, int tile) {
+    int unused, width = ctx->arena->width;
+    return findUnvisitedAround(ctx, tile % width, tile / width, &unused, &unused);
 }
 
-static void turnToDirection(Robot *robot, char target) {
-    while (robot->direction != target) {
-        right(robot);
+/* The frontier holds visited tiles that still border an unvisited passable
+   tile. Visiting a tile can only add itself and drop its neighbours */
+static void markVisited(ExplorationContext *ctx, int x, int y) {
+    int tile = y * ctx->arena->width + x;
+    ctx->visited[tileWord(ctx->arena, x, y)] |= tileMask(x);
+    if (bordersUnvisited(ctx, tile)) addFrontierTile(&ctx->frontier, tile);
+    for (int i = 0; i < 4; i++) {
+        int next = tile + DIRECTION_DY[i] * ctx->arena->width + DIRECTION_DX[i];
+        if (frontierContains(&ctx->frontier, next) && !bordersUnvisited(ctx, next)) {
+            removeFrontierTile(&ctx->frontier, next);
+        }
     }
 }
 
 static void collectAtPosition(Robot *robot, Arena *arena) {
     if (atMarker(robot, arena)) {
         pickUpMarker(robot, arena);
-        drawBackground(arena);
-        foreground();
+        markTileDirty(&g_dirty, robot->x, robot->y);
     }
 }
 
-static int findNearestUnvisited(ExplorationContext *ctx, int *targetX, int *targetY) {
-    for (int y = 1; y < ctx->arena->height - 1; y++) {
-        for (int x = 1; x < ctx->arena->width - 1; x++) {
-            if (isUnvisited(ctx, x, y)) {
-                *targetX = x;
-                *targetY = y;
-                return 1;
-            }
+/* Closest frontier tile by Manhattan distance; only the frontier is scanned */
+static int nearestFrontierTile(ExplorationContext *ctx) {
+    int width = ctx->arena->width, best = -1, bestDistance = 0;
+    for (int i = 0; i < ctx->frontier.count; i++) {
+        int tile = ctx->frontier.tiles[i];
+        int distance = abs(tile % width - ctx->robot->x) + abs(tile / width - ctx->robot->y);
+        if (best < 0 || distance < bestDistance || (distance == bestDistance && tile < best)) {
+            best = tile;
+            bestDistance = distance;
         }
     }
-    return 0;
+    return best;
+}
+
+/* Frontier tiles were reached, so their unvisited neighbours are reachable too */
+static int findNearestUnvisited(ExplorationContext *ctx, int *targetX, int *targetY) {
+    int tile = nearestFrontierTile(ctx);
+    if (tile < 0) return 0;
+    int width = ctx->arena->width;
+    return findUnvisitedAround(ctx, tile % width, tile / width, targetX, targetY);
+}
+
+static int searchPath(PathWorkspace *workspace, PathAlgorithm algorithm,
+                      int startX, int startY, int endX, int endY, Path *path) {
+    int found = findPathWith(workspace, algorithm, startX, startY, endX, endY, path);
+    g_stats.pathSearches++;
+    g_stats.nodesExpanded += path->expanded;
+    return found;
+}
+
+/* The heading search starts from the way the robot faces, so the first
+   turn is charged too */
+static int searchFromRobot(ExplorationContext *ctx, int endX, int endY) {
+    Robot *robot = ctx->robot;
+    if (g_pathAlgorithm != PATH_HEADING) {
+        return searchPath(&ctx->workspace, g_pathAlgorithm, robot->x, robot->y, endX, endY, &ctx->path);
+    }
+    int found = findPathTurning(&ctx->workspace, robot->x, robot->y,
+                                directionIndex(robot->direction), endX, endY, &ctx->path);
+    g_stats.pathSearches++;
+    g_stats.nodesExpanded += ctx->path.expanded;
+    return found;
+}
+
+static int isUnvisitedGoal(void *context, int x, int y) {
+    return isUnvisited(context, x, y);
 }
 
-/* Avoids pathfinding overhead for adjacent tiles */
+/* The robot's tile is always visited, so a found path is never empty */
+static int searchNearestUnvisited(ExplorationContext *ctx) {
+    Robot *robot = ctx->robot;
+    int found = g_pathAlgorithm == PATH_HEADING
+        ? findNearestPathTurning(&ctx->workspace, robot->x, robot->y,
+                                 directionIndex(robot->direction), isUnvisitedGoal, ctx, &ctx->path)
+        : findNearestPath(&ctx->workspace, robot->x, robot->y, isUnvisitedGoal, ctx, &ctx->path);
+    g_stats.pathSearches++;
+    g_stats.nodesExpanded += ctx->path.expanded;
+    return found;
+}
+
+static void moveRobotTo(Robot *robot, Arena *arena, int targetX, int targetY) {
+    g_stats.turns += turnTowards(robot, targetX, targetY);
+    forward(robot, arena);
+    g_stats.steps++;
+    recordMovement(&g_trail, robot->x, robot->y, robot->direction);
+    markTileDirty(&g_dirty, robot->x, robot->y);
+}
+
+/* Avoids pathfinding overhead for adjacent tiles. A step onto a tile the
+   robot has already stood on counts as a revisit */
 static void moveToAdjacent(ExplorationContext *ctx, int targetX, int targetY) {
-    char dir = getDirection(ctx->robot->x, ctx->robot->y, targetX, targetY);
-    turnToDirection(ctx->robot, dir);
-    forward(ctx->robot, ctx->arena);
-    recordMovement(&g_trail, ctx->robot->x, ctx->robot->y, ctx->robot->direction);
-    ctx->visited[ctx->robot->y][ctx->robot->x] = 1;
+    moveRobotTo(ctx->robot, ctx->arena, targetX, targetY);
+    if (!isUnvisited(ctx, ctx->robot->x, ctx->robot->y)) g_stats.revisits++;
+    markVisited(ctx, ctx->robot->x, ctx->robot->y);
     collectAtPosition(ctx->robot, ctx->arena);
-    drawRobot(ctx->robot);
-    drawMovementTrails(&g_trail, ctx->arena->width, ctx->arena->height);
-    sleep(ANIMATION_DELAY);
+    drawFrame(ctx->robot, ctx->arena);
 }
 
+/* The last step of a multi-step path ends a jump, an event worth drawing */
 static void followAndCollect(ExplorationContext *ctx, Path *path) {
     for (int i = 0; i < path->length; i++) {
-        char dir = getDirection(ctx->robot->x, ctx->robot->y, path->x[i], path->y[i]);
-        turnToDirection(ctx->robot, dir);
-        forward(ctx->robot, ctx->arena);
-        recordMovement(&g_trail, ctx->robot->x, ctx->robot->y, ctx->robot->direction);
-        ctx->visited[ctx->robot->y][ctx->robot->x] = 1;
-        collectAtPosition(ctx->robot, ctx->arena);
-        drawRobot(ctx->robot);
-        drawMovementTrails(&g_trail, ctx->arena->width, ctx->arena->height);
-        sleep(ANIMATION_DELAY);
+        if (i > 0 && i == path->length - 1) g_frames.event = 1;
+        moveToAdjacent(ctx, path->x[i], path->y[i]);
     }
 }
 
 static int tryAdjacentMove(ExplorationContext *ctx) {
     int nextX, nextY;
     if (!findAdjacentUnvisited(ctx, &nextX, &nextY)) return 0;
+    PROFILE_COUNT(PROFILE_GREEDY_MOVES, 1);
     moveToAdjacent(ctx, nextX, nextY);
     return 1;
 }
 
-static int tryJumpToUnvisited(ExplorationContext *ctx) {
+/* A* and jump point search need a target, so they jump next to the
+   nearest frontier tile */
+static int searchToFrontier(ExplorationContext *ctx) {
     int nextX, nextY;
     if (!findNearestUnvisited(ctx, &nextX, &nextY)) return 0;
+    return searchFromRobot(ctx, nextX, nextY);
+}
 
-    Path path;
-    if (findPath(ctx->arena, ctx->robot->x, ctx->robot->y, nextX, nextY, &path)) {
-        followAndCollect(ctx, &path);
-    }
+/* BFS and the heading search stop at the cheapest reachable unvisited tile
+   and return its path. An empty frontier means every reachable tile has
+   been visited */
+static int tryJumpToUnvisited(ExplorationContext *ctx) {
+    if (ctx->frontier.count == 0) return 0;
+    int nearest = g_pathAlgorithm == PATH_BFS || g_pathAlgorithm == PATH_HEADING;
+    int found = nearest ? searchNearestUnvisited(ctx) : searchToFrontier(ctx);
+    if (!found) return 0;
+    g_stats.jumps++;
+    PROFILE_COUNT(PROFILE_JUMPS, 1);
+    followAndCollect(ctx, &ctx->path);
     return 1;
 }
 
-/* Prioritizes adjacent moves, falls back to BFS pathfinding when needed */
-void exploreAndCollect(Robot *robot, Arena *arena) {
-    int visited[MAX_ARENA_SIZE][MAX_ARENA_SIZE] = {0};
-    ExplorationContext ctx = {robot, arena, visited};
+static int initExploration(ExplorationContext *ctx) {
+    size_t words = (size_t)ctx->arena->words_per_row * ctx->arena->height;
+    int tiles = ctx->arena->width * ctx->arena->height;
+    ctx->visited = calloc(words, sizeof(uint64_t));
+    if (ctx->visited == NULL || !initFrontierSet(&ctx->frontier, tiles) ||
+        !initPath(&ctx->path, tiles) || !initPathWorkspace(&ctx->workspace, ctx->arena)) {
+        return 0;
+    }
+    ctx->workspace.moveCost = g_moveCost;
+    ctx->workspace.turnCost = g_turnCost;
+    return preparePathSearch(&ctx->workspace, g_pathAlgorithm);
+}
 
-    visited[robot->y][robot->x] = 1;
-    collectAtPosition(robot, arena);
+/* Safe after a partial initExploration: unset members are zero */
+static void freeExploration(ExplorationContext *ctx) {
+    freePathWorkspace(&ctx->workspace);
+    freePath(&ctx->path);
+    freeFrontierSet(&ctx->frontier);
+    free(ctx->visited);
+}
 
-    while (tryAdjacentMove(&ctx) || tryJumpToUnvisited(&ctx)) {
-        if (countMarkers(arena) == 0) {
-            break;
+/* Prioritizes adjacent moves, falls back to BFS pathfinding when needed */
+void exploreAndCollect(Robot *robot, Arena *arena) {
+    ExplorationContext ctx = {robot, arena};
+
+    if (initExploration(&ctx)) {
+        markVisited(&ctx, robot->x, robot->y);
+        collectAtPosition(robot, arena);
+        while (tryAdjacentMove(&ctx) || tryJumpToUnvisited(&ctx)) {
+            if (countMarkers(arena) == 0) {
+                break;
+            }
         }
     }
+    freeExploration(&ctx);
 }
 
-/* Follows path without tracking visited tiles (for non-exploration movement) */
-void followPath(Robot *robot, Arena *arena, Path *path) {
-    for (int i = 0; i < path->length; i++) {
-        char dir = getDirection(robot->x, robot->y, path->x[i], path->y[i]);
-        turnToDirection(robot, dir);
-        forward(robot, arena);
-        recordMovement(&g_trail, robot->x, robot->y, robot->direction);
-        drawRobot(robot);
-        drawMovementTrails(&g_trail, arena->width, arena->height);
-        sleep(ANIMATION_DELAY);
+/* Markers picked up on an earlier leg are skipped */
+static void followTourLeg(ExplorationContext *ctx, int targetX, int targetY) {
+    if (!hasMarker(ctx->arena, targetX, targetY)) return;
+    if (searchFromRobot(ctx, targetX, targetY)) {
+        g_stats.jumps++;
+        followAndCollect(ctx, &ctx->path);
     }
 }
 
-static int findNearestCorner(Arena *arena, int x, int y, int *cornerX, int *cornerY) {
-    int corners[4][2] = {
-        {1, 1},
-        {arena->width - 2, 1},
-        {1, arena->height - 2},
-        {arena->width - 2, arena->height - 2}
-    };
+/* Visits the markers in the order planMarkerTour chose from the full map */
+void collectByTour(Robot *robot, Arena *arena) {
+    ExplorationContext ctx = {robot, arena};
+    MarkerTour tour;
 
-    int minDist = arena->width * arena->height;
-    int bestCorner = -1;
-
-    for (int i = 0; i < 4; i++) {
-        if (arena->grid[corners[i][1]][corners[i][0]] == EMPTY) {
-            int dx = corners[i][0] - x;
-            int dy = corners[i][1] - y;
-            int dist = dx * dx + dy * dy;
-            if (dist < minDist) {
-                minDist = dist;
-                bestCorner = i;
-            }
+    if (initExploration(&ctx) && planMarkerTour(arena, robot->x, robot->y, &tour)) {
+        markVisited(&ctx, robot->x, robot->y);
+        collectAtPosition(robot, arena);
+        for (int i = 0; i < tour.count; i++) {
+            followTourLeg(&ctx, tour.x[i], tour.y[i]);
         }
+        freeMarkerTour(&tour);
     }
+    freeExploration(&ctx);
+}
 
-    if (bestCorner == -1) return 0;
+/* A pass must run straight down its column, but HPA* paths cross cluster
+   borders only at entrances, which can lie in other columns, so its legs
+   use A* instead */
+static int searchCoverageLeg(ExplorationContext *ctx, int endX, int endY) {
+    if (g_pathAlgorithm != PATH_HIERARCHICAL) return searchFromRobot(ctx, endX, endY);
+    return searchPath(&ctx->workspace, PATH_ASTAR, ctx->robot->x, ctx->robot->y, endX, endY, &ctx->path);
+}
 
-    *cornerX = corners[bestCorner][0];
-    *cornerY = corners[bestCorner][1];
-    return 1;
+/* Stops once the last marker is picked up, like exploreAndCollect */
+static void followCoverageLeg(ExplorationContext *ctx, int targetX, int targetY) {
+    if (countMarkers(ctx->arena) == 0) return;
+    if (searchCoverageLeg(ctx, targetX, targetY)) {
+        followAndCollect(ctx, &ctx->path);
+    }
 }
 
-void deliverToCorner(Robot *robot, Arena *arena) {
-    int cornerX, cornerY;
-    if (!findNearestCorner(arena, robot->x, robot->y, &cornerX, &cornerY)) {
-        while (markerCount(robot) > 0) {
-            dropMarker(robot, arena);
+/* Runs the lawnmower waypoints planCoverage chose from the full map */
+void collectByCoverage(Robot *robot, Arena *arena) {
+    ExplorationContext ctx = {robot, arena};
+    CoveragePlan plan = {0};
+
+    if (initExploration(&ctx) && planCoverage(arena, robot->x, robot->y, &plan)) {
+        markVisited(&ctx, robot->x, robot->y);
+        collectAtPosition(robot, arena);
+        for (int i = 0; i < plan.count; i++) {
+            followCoverageLeg(&ctx, plan.x[i], plan.y[i]);
         }
-        drawBackground(arena);
-        foreground();
-        drawRobot(robot);
-        drawMovementTrails(&g_trail, arena->width, arena->height);
-        return;
     }
+    freeCoveragePlan(&plan);
+    freeExploration(&ctx);
+}
 
-    Path path;
-    if (findPath(arena, robot->x, robot->y, cornerX, cornerY, &path)) {
-        followPath(robot, arena, &path);
-    }
+/* Runs on a team thread, so it draws through the context, not g_dirty */
+static void drawTeamFrame(void *context, Arena *arena, Robot *robots, int count) {
+    TeamFrameContext *frame = context;
+    if (frame->trace != NULL) recordTraceFrame(frame->trace, robots, count);
+    if (g_headless || !passesFrameGate(frame->gate, arena)) return;
+    drawRobotFrame(frame->view.dirty, arena, frame->view.trail, robots, count, g_render.delay);
+}
+
+static void addRunStats(const RunStats *robot) {
+    g_stats.steps += robot->steps;
+    g_stats.revisits += robot->revisits;
+    g_stats.turns += robot->turns;
+    g_stats.jumps += robot->jumps;
+    g_stats.pathSearches += robot->pathSearches;
+    g_stats.nodesExpanded += robot->nodesExpanded;
+}
 
-    while (markerCount(robot) > 0) {
-        dropMarker(robot, arena);
+/* Counters are summed over the team; ticks is its time to finish */
+void exploreWithTeam(Robot *robots, Arena *arena) {
+    int framed = !g_headless || g_traceFile != NULL;
+    TeamFrameContext frame = {{&g_trail, &g_dirty, framed ? drawTeamFrame : NULL, NULL},
+                              g_traceFile != NULL ? &g_trace : NULL, &g_frames};
+    TeamResult result;
+
+    frame.view.context = &frame;
+    if (!exploreAsTeam(arena, robots, g_robots, &frame.view, &result)) {
+        fprintf(stderr, "team: out of memory or threads\n");
     }
-    drawBackground(arena);
-    foreground();
-    drawRobot(robot);
-    drawMovementTrails(&g_trail, arena->width, arena->height);
+    for (int i = 0; i < g_robots; i++) {
+        addRunStats(&result.robots[i]);
+    }
+    g_ticks = result.ticks;
 }
@@ -1,127 +1,254 @@
 #include <stdlib.h>
-#include "pathfinding.h"
-
-#define MAX_QUEUE_SIZE 400
+#include <string.h>
+#include "pathsearch.h"
+#include "profile.h"
 
+/* Each tile is enqueued at most once, so width * height slots never wrap */
 typedef struct {
-    int x[MAX_QUEUE_SIZE];
-    int y[MAX_QUEUE_SIZE];
+    int *tiles;
     int front, rear;
 } Queue;
 
-static void initQueue(Queue *q) {
-    q->front = 0;
-    q->rear = 0;
+/* visited[tile] is stamp[tile] == generation for the current query.
+   Without a goal function the search stops at end */
+typedef struct {
+    Arena *arena;
+    unsigned int *stamp;
+    unsigned int generation;
+    int *parent;
+    Queue queue;
+    int expanded;
+    int end;
+    TileGoal goal;
+    void *goalContext;
+} SearchBuffers;
+
+int initPath(Path *path, int capacity) {
+    path->x = malloc(2 * (size_t)capacity * sizeof(int));
+    path->y = path->x != NULL ? path->x + capacity : NULL;
+    path->length = 0;
+    path->expanded = 0;
+    path->capacity = path->x != NULL ? capacity : 0;
+    return path->x != NULL;
+}
+
+void freePath(Path *path) {
+    free(path->x);
+    path->x = NULL;
+    path->y = NULL;
+    path->capacity = 0;
+}
+
+/* One block: heap keys first for alignment, then the int arrays, then state */
+static void assignWorkspace(PathWorkspace *workspace, size_t nodes) {
+    workspace->stamp = (unsigned int *)(workspace->heapKeys + nodes);
+    workspace->cost = (int *)(workspace->stamp + nodes);
+    workspace->heapIndex = workspace->cost + nodes;
+    workspace->parent = workspace->heapIndex + nodes;
+    workspace->queue = workspace->parent + nodes;
+    workspace->state = (unsigned char *)(workspace->queue + nodes);
+}
+
+int initWorkspaceNodes(PathWorkspace *workspace, Arena *arena, size_t nodes) {
+    workspace->heapKeys = calloc(nodes, sizeof(uint64_t) + 5 * sizeof(int) + 1);
+    if (workspace->heapKeys == NULL) return 0;
+    workspace->arena = arena;
+    workspace->nodes = nodes;
+    workspace->generation = 0;
+    workspace->fields = NULL;
+    workspace->hierarchy = NULL;
+    workspace->headings = NULL;
+    workspace->moveCost = 1;
+    workspace->turnCost = 1;
+    assignWorkspace(workspace, nodes);
+    return 1;
+}
+
+int initPathWorkspace(PathWorkspace *workspace, Arena *arena) {
+    return initWorkspaceNodes(workspace, arena, (size_t)arena->width * arena->height);
+}
+
+void freePathWorkspace(PathWorkspace *workspace) {
+    free(workspace->heapKeys);
+    freeDistanceFields(workspace->fields);
+    freeHierarchy(workspace->hierarchy);
+    freeHeadingWorkspace(workspace);
+    workspace->heapKeys = NULL;
+    workspace->fields = NULL;
+    workspace->hierarchy = NULL;
+}
+
+/* Stamps are only cleared when the generation counter wraps */
+unsigned int nextGeneration(PathWorkspace *workspace) {
+    if (++workspace->generation == 0) {
+        memset(workspace->stamp, 0, workspace->nodes * sizeof(unsigned int));
+        workspace->generation = 1;
+    }
+    return workspace->generation;
+}
+
+/* Every BFS and A* query starts here, so it counts them */
+void beginSearch(PathWorkspace *workspace) {
+    PROFILE_COUNT(PROFILE_SEARCHES, 1);
+    nextGeneration(workspace);
 }
 
 static int isQueueEmpty(Queue *q) {
     return q->front == q->rear;
 }
 
-static void enqueue(Queue *q, int x, int y) {
-    q->x[q->rear] = x;
-    q->y[q->rear] = y;
-    q->rear = (q->rear + 1) % MAX_QUEUE_SIZE;
+static void enqueue(Queue *q, int tile) {
+    q->tiles[q->rear++] = tile;
 }
 
-static void dequeue(Queue *q, int *x, int *y) {
-    *x = q->x[q->front];
-    *y = q->y[q->front];
-    q->front = (q->front + 1) % MAX_QUEUE_SIZE;
+static int dequeue(Queue *q) {
+    return q->tiles[q->front++];
 }
 
-static int isValidMove(Arena *arena, int visited[][MAX_ARENA_SIZE], int x, int y) {
-    if (x <= 0 || x >= arena->width-1 || y <= 0 || y >= arena->height-1) return 0;
-    if (visited[y][x]) return 0;
-    if (arena->grid[y][x] == WALL || arena->grid[y][x] == OBSTACLE) return 0;
-    return 1;
+/* The border is impassable, so neighbours of searched tiles never leave the grid */
+static int isValidMove(SearchBuffers *buffers, int x, int y) {
+    Arena *arena = buffers->arena;
+    return isPassable(arena, x, y) && buffers->stamp[y * arena->width + x] != buffers->generation;
 }
 
-static int tracePath(int parentX[][MAX_ARENA_SIZE], int parentY[][MAX_ARENA_SIZE],
-                     int startX, int startY, int endX, int endY,
-                     int tempX[], int tempY[]) {
-    int x = endX, y = endY, len = 0;
-    while (x != startX || y != startY) {
-        tempX[len] = x;
-        tempY[len] = y;
-        int px = parentX[y][x], py = parentY[y][x];
-        x = px; y = py;
+static int pathLength(const int *parent, int start, int end) {
+    int len = 0;
+    for (int tile = end; tile != start; tile = parent[tile]) {
         len++;
     }
     return len;
 }
 
-static void reversePath(int tempX[], int tempY[], int len, Path *path) {
-    for (int i = 0; i < len; i++) {
-        path->x[i] = tempX[len - 1 - i];
-        path->y[i] = tempY[len - 1 - i];
-    }
+int buildPathFromParents(Arena *arena, const int *parent, int start, int end, Path *path) {
+    int len = pathLength(parent, start, end);
+    if (len > path->capacity) return 0;
     path->length = len;
+    for (int tile = end; tile != start; tile = parent[tile]) {
+        len--;
+        path->x[len] = tile % arena->width;
+        path->y[len] = tile / arena->width;
+    }
+    return 1;
 }
 
-static void reconstructPath(int parentX[][MAX_ARENA_SIZE],
-                           int parentY[][MAX_ARENA_SIZE],
-                           int startX, int startY, int endX, int endY,
-                           Path *path) {
-    int tempX[MAX_PATH_LENGTH], tempY[MAX_PATH_LENGTH];
-    int len = tracePath(parentX, parentY, startX, startY, endX, endY,
-                        tempX, tempY);
-    reversePath(tempX, tempY, len, path);
-}
-
-static void processNeighbors(Arena *arena, int x, int y,
-                             int visited[][MAX_ARENA_SIZE],
-                             int parentX[][MAX_ARENA_SIZE],
-                             int parentY[][MAX_ARENA_SIZE], Queue *q) {
+static void processNeighbors(SearchBuffers *buffers, int tile) {
+    int width = buffers->arena->width;
+    int x = tile % width, y = tile / width;
     for (int i = 0; i < 4; i++) {
         int nx = x + DIRECTION_DX[i], ny = y + DIRECTION_DY[i];
-        if (isValidMove(arena, visited, nx, ny)) {
-            visited[ny][nx] = 1;
-            parentX[ny][nx] = x;
-            parentY[ny][nx] = y;
-            enqueue(q, nx, ny);
+        if (isValidMove(buffers, nx, ny)) {
+            int next = ny * width + nx;
+            buffers->stamp[next] = buffers->generation;
+            buffers->parent[next] = tile;
+            enqueue(&buffers->queue, next);
         }
     }
 }
 
-static int bfsSearch(Arena *arena, int startX, int startY, int endX, int endY,
-                     int visited[][MAX_ARENA_SIZE],
-                     int parentX[][MAX_ARENA_SIZE],
-                     int parentY[][MAX_ARENA_SIZE], Queue *q) {
-    enqueue(q, startX, startY);
-    visited[startY][startX] = 1;
-    while (!isQueueEmpty(q)) {
-        int x, y;
-        dequeue(q, &x, &y);
-        if (x == endX && y == endY) return 1;
-        processNeighbors(arena, x, y, visited, parentX, parentY, q);
-    }
-    return 0;
+static int isGoalTile(SearchBuffers *buffers, int tile) {
+    int width = buffers->arena->width;
+    if (buffers->goal == NULL) return tile == buffers->end;
+    return buffers->goal(buffers->goalContext, tile % width, tile / width);
 }
 
-static void initPathfinding(int visited[][MAX_ARENA_SIZE], Queue *queue) {
-    for (int i = 0; i < MAX_ARENA_SIZE; i++) {
-        for (int j = 0; j < MAX_ARENA_SIZE; j++) {
-            visited[i][j] = 0;
-        }
+/* Returns the first goal tile dequeued, or -1 */
+static int bfsSearch(SearchBuffers *buffers, int start) {
+    enqueue(&buffers->queue, start);
+    buffers->stamp[start] = buffers->generation;
+    while (!isQueueEmpty(&buffers->queue)) {
+        PROFILE_PEAK(PROFILE_BFS_QUEUE, buffers->queue.rear - buffers->queue.front);
+        int tile = dequeue(&buffers->queue);
+        if (isGoalTile(buffers, tile)) return tile;
+        PROFILE_COUNT(PROFILE_EXPANDED, 1);
+        buffers->expanded++;
+        processNeighbors(buffers, tile);
     }
-    initQueue(queue);
+    return -1;
+}
+
+static void initPathfinding(SearchBuffers *buffers, PathWorkspace *workspace) {
+    beginSearch(workspace);
+    buffers->arena = workspace->arena;
+    buffers->stamp = workspace->stamp;
+    buffers->generation = workspace->generation;
+    buffers->parent = workspace->parent;
+    buffers->queue.tiles = workspace->queue;
+    buffers->queue.front = 0;
+    buffers->queue.rear = 0;
+    buffers->expanded = 0;
+    buffers->goal = NULL;
 }
 
 /* BFS pathfinding adapted from: https://github.com/rodriguesrenato/coverage-path-planning */
+static int findPathBfs(PathWorkspace *workspace, int startX, int startY,
+                       int endX, int endY, Path *path) {
+    SearchBuffers buffers;
+    Arena *arena = workspace->arena;
+    int found = 0;
+    initPathfinding(&buffers, workspace);
+
+    int start = startY * arena->width + startX;
+    buffers.end = endY * arena->width + endX;
+    if (bfsSearch(&buffers, start) >= 0) {
+        found = buildPathFromParents(arena, buffers.parent, start, buffers.end, path);
+    }
+    path->expanded = buffers.expanded;
+    return found;
+}
+
+int findNearestPath(PathWorkspace *workspace, int startX, int startY,
+                    TileGoal goal, void *context, Path *path) {
+    SearchBuffers buffers;
+    int found = 0;
+    path->length = 0;
+    initPathfinding(&buffers, workspace);
+    buffers.goal = goal;
+    buffers.goalContext = context;
+
+    int start = startY * workspace->arena->width + startX;
+    int end = bfsSearch(&buffers, start);
+    if (end >= 0) found = buildPathFromParents(workspace->arena, buffers.parent, start, end, path);
+    path->expanded = buffers.expanded;
+    return found;
+}
+
 int findPath(Arena *arena, int startX, int startY,
              int endX, int endY, Path *path) {
-    int visited[MAX_ARENA_SIZE][MAX_ARENA_SIZE];
-    int parentX[MAX_ARENA_SIZE][MAX_ARENA_SIZE];
-    int parentY[MAX_ARENA_SIZE][MAX_ARENA_SIZE];
-    Queue queue;
-    initPathfinding(visited, &queue);
+    return findPathUsing(PATH_BFS, arena, startX, startY, endX, endY, path);
+}
 
-    if (bfsSearch(arena, startX, startY, endX, endY,
-                  visited, parentX, parentY, &queue)) {
-        reconstructPath(parentX, parentY, startX, startY, endX, endY, path);
-        return 1;
-    }
+const char *pathAlgorithmName(PathAlgorithm algorithm) {
+    static const char *names[PATH_ALGORITHM_COUNT] = {"bfs", "astar", "jps", "field", "heading", "bidir", "hpa"};
+    return names[algorithm];
+}
+
+/* Indexed by PathAlgorithm, in the order of its names */
+typedef int (*PathSearch)(PathWorkspace *workspace, int startX, int startY,
+                          int endX, int endY, Path *path);
+
+int findPathWith(PathWorkspace *workspace, PathAlgorithm algorithm, int startX, int startY,
+                 int endX, int endY, Path *path) {
+    static const PathSearch searches[PATH_ALGORITHM_COUNT] = {findPathBfs, findPathAStar,
+        findPathJumpPoint, findPathDistanceField, findPathHeading, findPathBidirectional,
+        findPathHierarchical};
+    path->length = 0;
+    path->expanded = 0;
+    return searches[algorithm](workspace, startX, startY, endX, endY, path);
+}
+
+int preparePathSearch(PathWorkspace *workspace, PathAlgorithm algorithm) {
+    if (algorithm == PATH_HIERARCHICAL) return prepareHierarchy(workspace);
+    return 1;
+}
+
+/* One-off query: allocates a workspace for this call only */
+int findPathUsing(PathAlgorithm algorithm, Arena *arena, int startX, int startY,
+                  int endX, int endY, Path *path) {
+    PathWorkspace workspace;
     path->length = 0;
-    return 0;
+    path->expanded = 0;
+    if (!initPathWorkspace(&workspace, arena)) return 0;
+    int found = findPathWith(&workspace, algorithm, startX, startY, endX, endY, path);
+    freePathWorkspace(&workspace);
+    return found;
 }
@@ -3,16 +3,100 @@
 
 #include "arena.h"
 
-#define MAX_PATH_LENGTH 200
-
+/* Tiles after the start, in order; capacity of width * height always suffices.
+   expanded counts the tiles the search that produced it expanded */
 typedef struct {
-    int x[MAX_PATH_LENGTH];
-    int y[MAX_PATH_LENGTH];
+    int *x;
+    int *y;
     int length;
+    int capacity;
+    int expanded;
 } Path;
 
+typedef enum {
+    PATH_BFS,
+    PATH_ASTAR,
+    PATH_JUMP_POINT,
+    PATH_DISTANCE_FIELD,
+    PATH_HEADING,
+    PATH_BIDIRECTIONAL,
+    PATH_HIERARCHICAL
+} PathAlgorithm;
+
+#define PATH_ALGORITHM_COUNT 7
+
+/* Cached BFS distance maps keyed by target tile (distance.c) */
+typedef struct DistanceFieldCache DistanceFieldCache;
+/* Cluster graph for PATH_HIERARCHICAL (hpa.c) */
+typedef struct HierarchyGraph HierarchyGraph;
+
+/* Search buffers kept across queries on one arena, one slot per search
+   node. A node's marks count only while its stamp equals generation, so a
+   new query bumps generation instead of clearing them. moveCost and
+   turnCost weigh a forward step and a 90 degree turn for PATH_HEADING,
+   which searches (x, y, heading) nodes in the headings workspace */
+typedef struct PathWorkspace {
+    Arena *arena;
+    size_t nodes;
+    unsigned int *stamp;
+    unsigned int generation;
+    uint64_t *heapKeys;
+    int *queue;
+    int *heapIndex;
+    int *cost;
+    int *parent;
+    unsigned char *state;
+    DistanceFieldCache *fields;
+    HierarchyGraph *hierarchy;
+    struct PathWorkspace *headings;
+    int moveCost;
+    int turnCost;
+} PathWorkspace;
+
+int initPath(Path *path, int capacity);
+void freePath(Path *path);
+
+int initPathWorkspace(PathWorkspace *workspace, Arena *arena);
+void freePathWorkspace(PathWorkspace *workspace);
+
 /* BFS pathfinding. Returns 1 if path found, 0 otherwise */
 int findPath(Arena *arena, int startX, int startY,
              int endX, int endY, Path *path);
 
+const char *pathAlgorithmName(PathAlgorithm algorithm);
+
+/* Same result layout as findPath, searched with the chosen algorithm */
+int findPathUsing(PathAlgorithm algorithm, Arena *arena, int startX, int startY,
+                  int endX, int endY, Path *path);
+
+/* Matches the tiles a nearest-tile search may stop at */
+typedef int (*TileGoal)(void *context, int x, int y);
+
+/* One BFS from the start to the closest tile satisfying goal; the path ends
+   on that tile. Returns 0 if no reachable tile matches */
+int findNearestPath(PathWorkspace *workspace, int startX, int startY,
+                    TileGoal goal, void *context, Path *path);
+
+/* PATH_HEADING from a known start heading (negative for any) */
+int findPathTurning(PathWorkspace *workspace, int startX, int startY, int heading,
+                    int endX, int endY, Path *path);
+
+/* findNearestPath weighing turns: heading indexes DIRECTION_DX and the goal
+   tile reached with the least moveCost * moves + turnCost * turns wins */
+int findNearestPathTurning(PathWorkspace *workspace, int startX, int startY, int heading,
+                           TileGoal goal, void *context, Path *path);
+
+/* findPathUsing on the workspace's arena without allocating per query */
+int findPathWith(PathWorkspace *workspace, PathAlgorithm algorithm, int startX, int startY,
+                 int endX, int endY, Path *path);
+
+/* Builds what the algorithm keeps per arena, so the first query doesn't
+   pay for it. Returns 0 if that can't be allocated */
+int preparePathSearch(PathWorkspace *workspace, PathAlgorithm algorithm);
+
+/* Call once after each setTile that flips (x, y)'s passability, so
+   PATH_HIERARCHICAL rebuilds only the clusters it touches. Any flip not
+   reported here makes the next query rebuild the whole graph */
+void invalidatePathTile(PathWorkspace *workspace, int x, int y);
+
 #endif
@@ -0,0 +1,76 @@
+#ifndef PATHSEARCH_H
+#define PATHSEARCH_H
+
+#include "pathfinding.h"
+
+/* Helpers shared by the findPath algorithms; not part of the public API */
+
+typedef struct AStarSearch AStarSearch;
+
+/* Generates the successors of a popped node through relaxSuccessor */
+typedef void (*ExpandFunction)(AStarSearch *search, int node);
+/* Admissible, consistent lower bound on the remaining cost from a node */
+typedef int (*EstimateFunction)(AStarSearch *search, int node);
+/* Accepts the popped node that ends the search */
+typedef int (*ReachedFunction)(AStarSearch *search, int node);
+
+/* Best-first search over nodes, which are tiles unless the hooks say
+   otherwise. The open set is a binary min-heap and heapIndex maps a node to
+   its heap slot so a cheaper route can lower its key in place. Buffers
+   belong to the workspace; state is only read for nodes stamped with this
+   search's generation. parent[start] == start. context is for the hooks */
+struct AStarSearch {
+    Arena *arena;
+    unsigned int *stamp;
+    unsigned int generation;
+    int endX, endY, end;
+    uint64_t *heapKeys;
+    int *heapTiles;
+    int *heapIndex;
+    int *cost;
+    int *parent;
+    unsigned char *state;
+    int heapSize;
+    int expanded;
+    ExpandFunction expand;
+    EstimateFunction estimate;
+    ReachedFunction reached;
+    void *context;
+};
+
+/* Starts a query: every node becomes unmarked */
+void beginSearch(PathWorkspace *workspace);
+/* A stamp value no node holds yet, for a query that needs a second mark */
+unsigned int nextGeneration(PathWorkspace *workspace);
+/* Allocates buffers for nodes search nodes over arena */
+int initWorkspaceNodes(PathWorkspace *workspace, Arena *arena, size_t nodes);
+
+/* Tile search towards (endX, endY) with Manhattan estimate */
+void initAStar(AStarSearch *search, PathWorkspace *workspace, int endX, int endY);
+void relaxSuccessor(AStarSearch *search, int node, int next, int stepCost);
+/* Opens node at cost 0; call once per start before astarSearch */
+void addSearchStart(AStarSearch *search, int node);
+/* Returns the first node accepted by reached, or -1 */
+int astarSearch(AStarSearch *search);
+
+int buildPathFromParents(Arena *arena, const int *parent, int start, int end, Path *path);
+
+int findPathAStar(PathWorkspace *workspace, int startX, int startY,
+                  int endX, int endY, Path *path);
+int findPathJumpPoint(PathWorkspace *workspace, int startX, int startY,
+                      int endX, int endY, Path *path);
+int findPathDistanceField(PathWorkspace *workspace, int startX, int startY,
+                          int endX, int endY, Path *path);
+int findPathHeading(PathWorkspace *workspace, int startX, int startY,
+                    int endX, int endY, Path *path);
+int findPathBidirectional(PathWorkspace *workspace, int startX, int startY,
+                          int endX, int endY, Path *path);
+int findPathHierarchical(PathWorkspace *workspace, int startX, int startY,
+                         int endX, int endY, Path *path);
+/* Builds or refreshes the workspace's cluster graph */
+int prepareHierarchy(PathWorkspace *workspace);
+void freeHierarchy(HierarchyGraph *graph);
+void freeHeadingWorkspace(PathWorkspace *workspace);
+void freeDistanceFields(DistanceFieldCache *cache);
+
+#endif
@@ -0,0 +1,89 @@
+#ifndef NO_PROFILE
+#include <pthread.h>
+#include <time.h>
+#include "profile.h"
+
+_Thread_local Profile g_profile;
+
+static Profile totals;
+static pthread_mutex_t totalsLock = PTHREAD_MUTEX_INITIALIZER;
+
+static const char *COUNTER_NAMES[PROFILE_COUNTER_COUNT] = {
+    "forward", "left", "right", "path_searches", "nodes_expanded",
+    "greedy_moves", "jumps", "block_replay_bytes"
+};
+static const char *PEAK_NAMES[PROFILE_PEAK_COUNT] = {"bfs_queue", "astar_heap"};
+static const char *PHASE_NAMES[PROFILE_PHASE_COUNT] = {"generate", "explore", "render"};
+
+uint64_t profileClockNs(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000u + (uint64_t)now.tv_nsec;
+}
+
+void profileDraw(const char *code, size_t bytes) {
+    int slot = (code[0] - 'A') * 26 + (code[1] - 'A');
+    g_profile.drawCommands[slot]++;
+    g_profile.drawBytes[slot] += bytes;
+}
+
+static void addValues(uint64_t *total, uint64_t *values, int count) {
+    for (int i = 0; i < count; i++) total[i] += values[i];
+}
+
+void flushProfile(void) {
+    pthread_mutex_lock(&totalsLock);
+    addValues(totals.counters, g_profile.counters, PROFILE_COUNTER_COUNT);
+    for (int i = 0; i < PROFILE_PEAK_COUNT; i++) {
+        if (g_profile.peaks[i] > totals.peaks[i]) totals.peaks[i] = g_profile.peaks[i];
+    }
+    addValues(totals.phaseNs, g_profile.phaseNs, PROFILE_PHASE_COUNT);
+    addValues(totals.drawCommands, g_profile.drawCommands, PROFILE_DRAW_CODES);
+    addValues(totals.drawBytes, g_profile.drawBytes, PROFILE_DRAW_CODES);
+    pthread_mutex_unlock(&totalsLock);
+    g_profile = (Profile){0};
+}
+
+static void writeObject(FILE *file, const char *name, const char **names,
+                        const uint64_t *values, int count) {
+    fprintf(file, "  \"%s\": {", name);
+    for (int i = 0; i < count; i++) {
+        fprintf(file, "%s\"%s\": %llu", i ? ", " : "", names[i], (unsigned long long)values[i]);
+    }
+    fprintf(file, "},\n");
+}
+
+static void writePhases(FILE *file) {
+    fprintf(file, "  \"phases_ms\": {");
+    for (int i = 0; i < PROFILE_PHASE_COUNT; i++) {
+        fprintf(file, "%s\"%s\": %.3f", i ? ", " : "", PHASE_NAMES[i], totals.phaseNs[i] / 1e6);
+    }
+    fprintf(file, "},\n");
+}
+
+/* Only commands that were emitted are listed */
+static void writeDrawCommands(FILE *file) {
+    int listed = 0;
+    fprintf(file, "  \"draw\": {");
+    for (int slot = 0; slot < PROFILE_DRAW_CODES; slot++) {
+        if (totals.drawCommands[slot] == 0) continue;
+        fprintf(file, "%s\"%c%c\": {\"commands\": %llu, \"bytes\": %llu}", listed++ ? ", " : "",
+                'A' + slot / 26, 'A' + slot % 26, (unsigned long long)totals.drawCommands[slot],
+                (unsigned long long)totals.drawBytes[slot]);
+    }
+    fprintf(file, "}\n");
+}
+
+int writeProfileJson(FILE *file) {
+    flushProfile();
+    pthread_mutex_lock(&totalsLock);
+    fprintf(file, "{\n");
+    writeObject(file, "counters", COUNTER_NAMES, totals.counters, PROFILE_COUNTER_COUNT);
+    writeObject(file, "peaks", PEAK_NAMES, totals.peaks, PROFILE_PEAK_COUNT);
+    writePhases(file);
+    writeDrawCommands(file);
+    fprintf(file, "}\n");
+    pthread_mutex_unlock(&totalsLock);
+    return !ferror(file);
+}
+#endif
@@ -0,0 +1,74 @@
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+typedef enum {
+    PROFILE_FORWARD,
+    PROFILE_LEFT,
+    PROFILE_RIGHT,
+    PROFILE_SEARCHES,
+    PROFILE_EXPANDED,
+    PROFILE_GREEDY_MOVES,
+    PROFILE_JUMPS,
+    PROFILE_BLOCK_BYTES,
+    PROFILE_COUNTER_COUNT
+} ProfileCounter;
+
+/* High-water marks: the most entries a search queue held at once */
+typedef enum {
+    PROFILE_BFS_QUEUE,
+    PROFILE_ASTAR_HEAP,
+    PROFILE_PEAK_COUNT
+} ProfilePeak;
+
+/* Phase times are summed over threads. Exploration includes the frames
+   drawn during it */
+typedef enum {
+    PROFILE_GENERATE,
+    PROFILE_EXPLORE,
+    PROFILE_RENDER,
+    PROFILE_PHASE_COUNT
+} ProfilePhase;
+
+/* drawapp commands are two capital letters, so each has a slot */
+#define PROFILE_DRAW_CODES (26 * 26)
+
+typedef struct {
+    uint64_t counters[PROFILE_COUNTER_COUNT];
+    uint64_t peaks[PROFILE_PEAK_COUNT];
+    uint64_t phaseNs[PROFILE_PHASE_COUNT];
+    uint64_t drawCommands[PROFILE_DRAW_CODES];
+    uint64_t drawBytes[PROFILE_DRAW_CODES];
+} Profile;
+
+/* Building with -DNO_PROFILE compiles every hook below out. Otherwise
+   each thread counts into its own Profile and flushProfile adds it to the
+   process totals, so the hot paths never share a cache line */
+#ifdef NO_PROFILE
+#define PROFILE_COUNT(counter, amount) ((void)0)
+#define PROFILE_PEAK(peak, value) ((void)0)
+#define PROFILE_TIMER(name)
+#define PROFILE_ELAPSED(phase, name) ((void)0)
+#define PROFILE_FLUSH() ((void)0)
+#else
+extern _Thread_local Profile g_profile;
+
+#define PROFILE_COUNT(counter, amount) (g_profile.counters[counter] += (uint64_t)(amount))
+#define PROFILE_PEAK(peak, value) \
+    ((uint64_t)(value) > g_profile.peaks[peak] ? (void)(g_profile.peaks[peak] = (uint64_t)(value)) : (void)0)
+#define PROFILE_TIMER(name) uint64_t name = profileClockNs()
+#define PROFILE_ELAPSED(phase, name) (g_profile.phaseNs[phase] += profileClockNs() - (name))
+#define PROFILE_FLUSH() flushProfile()
+
+uint64_t profileClockNs(void);
+void profileDraw(const char *code, size_t bytes);
+/* Adds the calling thread's counts to the totals; threads call it last */
+void flushProfile(void);
+/* Flushes the calling thread, then writes the totals as one JSON object */
+int writeProfileJson(FILE *file);
+#endif
+
+#endif
@@ -0,0 +1,29 @@
+#include "graphics.h"
+#include "profile.h"
+#include "render.h"
+
+void initFrameGate(FrameGate *gate, const RenderSettings *settings, Arena *arena) {
+    *gate = (FrameGate){settings, 0, 0, countMarkers(arena), 0};
+}
+
+int passesFrameGate(FrameGate *gate, Arena *arena) {
+    int markers = countMarkers(arena);
+    RenderMode mode = gate->settings->mode;
+    int drawn = mode == RENDER_ALL ||
+                (mode == RENDER_EVERY && ++gate->frames % gate->settings->every == 0) ||
+                (mode == RENDER_EVENTS && (gate->event || markers != gate->markers));
+    gate->markers = markers;
+    gate->event = 0;
+    gate->skipped = !drawn;
+    return drawn;
+}
+
+void drawRobotFrame(DirtyTiles *dirty, Arena *arena, MovementTrail *trail,
+                    Robot *robots, int count, int delay) {
+    PROFILE_TIMER(start);
+    drawDirtyTiles(dirty, arena, trail);
+    foreground();
+    drawRobots(robots, count);
+    sleep(delay);
+    PROFILE_ELAPSED(PROFILE_RENDER, start);
+}
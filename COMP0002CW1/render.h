@@ -0,0 +1,41 @@
+#ifndef RENDER_H
+#define RENDER_H
+
+#include "arena.h"
+
+/* Which frames a run draws. Skipped frames still update the trail and the
+   dirty tiles, so the next drawn frame repaints everything that changed */
+typedef enum {
+    RENDER_ALL,
+    RENDER_EVERY,
+    RENDER_EVENTS,
+    RENDER_FINAL
+} RenderMode;
+
+/* every is the spacing for RENDER_EVERY; delay is the pause after a
+   drawn frame in ms */
+typedef struct {
+    RenderMode mode;
+    int every;
+    int delay;
+} RenderSettings;
+
+/* One run's frames. RENDER_EVENTS draws a frame when the marker count
+   has changed since the last one or the run set event. skipped says the
+   last frame counted was not drawn */
+typedef struct {
+    const RenderSettings *settings;
+    int frames;
+    int skipped;
+    int markers;
+    int event;
+} FrameGate;
+
+void initFrameGate(FrameGate *gate, const RenderSettings *settings, Arena *arena);
+/* Counts one frame and returns whether to draw it */
+int passesFrameGate(FrameGate *gate, Arena *arena);
+/* Repaints the dirty tiles and their trails, redraws the robots and pauses */
+void drawRobotFrame(DirtyTiles *dirty, Arena *arena, MovementTrail *trail,
+                    Robot *robots, int count, int delay);
+
+#endif
@@ -1,5 +1,6 @@
 #include "robot.h"
 #include "arena.h"
+#include "profile.h"
 
 static void getNextPos(Robot *robot, int *newX, int *newY) {
     *newX = robot->x;
@@ -12,15 +13,17 @@ static void getNextPos(Robot *robot, int *newX, int *newY) {
 
 void forward(Robot *robot, Arena *arena) {
     int newX, newY;
+    PROFILE_COUNT(PROFILE_FORWARD, 1);
     getNextPos(robot, &newX, &newY);
 
-    if (arena->grid[newY][newX] != WALL && arena->grid[newY][newX] != OBSTACLE) {
+    if (isPassable(arena, newX, newY)) {
         robot->x = newX;
         robot->y = newY;
     }
 }
 
 void left(Robot *robot) {
+    PROFILE_COUNT(PROFILE_LEFT, 1);
     if (robot->direction == 'N') robot->direction = 'W';
     else if (robot->direction == 'W') robot->direction = 'S';
     else if (robot->direction == 'S') robot->direction = 'E';
@@ -28,6 +31,7 @@ void left(Robot *robot) {
 }
 
 void right(Robot *robot) {
+    PROFILE_COUNT(PROFILE_RIGHT, 1);
     if (robot->direction == 'N') robot->direction = 'E';
     else if (robot->direction == 'E') robot->direction = 'S';
     else if (robot->direction == 'S') robot->direction = 'W';
@@ -35,31 +39,53 @@ void right(Robot *robot) {
 }
 
 int atMarker(Robot *robot, Arena *arena) {
-    return arena->grid[robot->y][robot->x] == MARKER;
+    return hasMarker(arena, robot->x, robot->y);
 }
 
 int canMoveForward(Robot *robot, Arena *arena) {
     int newX, newY;
     getNextPos(robot, &newX, &newY);
-    return arena->grid[newY][newX] != WALL && arena->grid[newY][newX] != OBSTACLE;
+    return isPassable(arena, newX, newY);
 }
 
+/* Atomic, so robots on other threads sharing the arena can neither take
+   the same marker nor lose a count. Marker tiles stay passable */
 void pickUpMarker(Robot *robot, Arena *arena) {
-    if (arena->grid[robot->y][robot->x] == MARKER) {
-        arena->grid[robot->y][robot->x] = EMPTY;
+    uint64_t mask = tileMask(robot->x);
+    uint64_t *word = &arena->markers[tileWord(arena, robot->x, robot->y)];
+    if (__atomic_fetch_and(word, ~mask, __ATOMIC_ACQ_REL) & mask) {
         robot->markers_held++;
-        arena->marker_count--;
+        __atomic_fetch_sub(&arena->marker_count, 1, __ATOMIC_ACQ_REL);
     }
 }
 
 void dropMarker(Robot *robot, Arena *arena) {
     if (robot->markers_held > 0) {
-        arena->grid[robot->y][robot->x] = MARKER;
+        setTile(arena, robot->x, robot->y, MARKER);
         robot->markers_held--;
         arena->marker_count++;
     }
 }
 
+/* Index into DIRECTION_DX, clockwise from north */
+int directionIndex(char direction) {
+    if (direction == 'E') return 1;
+    if (direction == 'S') return 2;
+    if (direction == 'W') return 3;
+    return 0;
+}
+
+/* Faces the adjacent tile (x, y) the shorter way round and returns the
+   number of turns taken, so no turn needs more than two calls */
+int turnTowards(Robot *robot, int x, int y) {
+    static const char directions[] = {'N', 'E', 'S', 'W'};
+    int target = x > robot->x ? 1 : x < robot->x ? 3 : y > robot->y ? 2 : 0;
+    int clockwise = (target - directionIndex(robot->direction) + 4) % 4;
+    if (clockwise == 3) left(robot);
+    while (robot->direction != directions[target]) right(robot);
+    return clockwise == 3 ? 1 : clockwise;
+}
+
 int markerCount(Robot *robot) {
     return robot->markers_held;
 }
@@ -0,0 +1,164 @@
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "profile.h"
+#include "runner.h"
+
+/* A worker's unclaimed seed offsets are [next, end) */
+typedef struct {
+    pthread_mutex_t lock;
+    size_t next;
+    size_t end;
+} SeedRange;
+
+typedef struct {
+    SeedRange ranges[MAX_JOBS];
+    int jobs;
+    unsigned int firstSeed;
+    SeedJob job;
+    void *context;
+    RunRecord *records;
+} SeedPool;
+
+typedef struct {
+    SeedPool *pool;
+    int index;
+} SeedWorker;
+
+static int takeSeed(SeedRange *range, size_t *offset) {
+    pthread_mutex_lock(&range->lock);
+    int taken = range->next < range->end;
+    if (taken) *offset = range->next++;
+    pthread_mutex_unlock(&range->lock);
+    return taken;
+}
+
+static size_t remainingSeeds(SeedRange *range) {
+    pthread_mutex_lock(&range->lock);
+    size_t remaining = range->end - range->next;
+    pthread_mutex_unlock(&range->lock);
+    return remaining;
+}
+
+static int fullestRange(SeedPool *pool, int thief) {
+    int victim = -1;
+    size_t most = 0;
+    for (int i = 0; i < pool->jobs; i++) {
+        size_t remaining = i == thief ? 0 : remainingSeeds(&pool->ranges[i]);
+        if (remaining > most) {
+            most = remaining;
+            victim = i;
+        }
+    }
+    return victim;
+}
+
+/* Cuts the back half off from's range under its lock, since its owner
+   and other thieves may have shrunk it since the scan. Returns the number
+   of seeds cut, starting at *start */
+static size_t splitRange(SeedRange *from, size_t *start) {
+    pthread_mutex_lock(&from->lock);
+    size_t half = (from->end - from->next + 1) / 2;
+    from->end -= half;
+    *start = from->end;
+    pthread_mutex_unlock(&from->lock);
+    return half;
+}
+
+/* Moves the back half of the fullest other range into the thief's empty
+   one; a steal that comes back empty rescans */
+static int stealSeeds(SeedPool *pool, int thief) {
+    int victim;
+    while ((victim = fullestRange(pool, thief)) >= 0) {
+        SeedRange *to = &pool->ranges[thief];
+        size_t start, half = splitRange(&pool->ranges[victim], &start);
+        if (half == 0) continue;
+        pthread_mutex_lock(&to->lock);
+        to->next = start;
+        to->end = start + half;
+        pthread_mutex_unlock(&to->lock);
+        return 1;
+    }
+    return 0;
+}
+
+/* Other thieves may empty the range again before the owner takes from it */
+static int nextSeed(SeedPool *pool, int index, size_t *offset) {
+    while (!takeSeed(&pool->ranges[index], offset)) {
+        if (!stealSeeds(pool, index)) return 0;
+    }
+    return 1;
+}
+
+static void *runWorker(void *argument) {
+    SeedWorker *worker = argument;
+    SeedPool *pool = worker->pool;
+    size_t offset;
+    while (nextSeed(pool, worker->index, &offset)) {
+        pool->job(pool->context, pool->firstSeed + (unsigned int)offset, &pool->records[offset]);
+    }
+    PROFILE_FLUSH();
+    return NULL;
+}
+
+static void initPool(SeedPool *pool, size_t count, int jobs) {
+    pool->jobs = jobs;
+    for (int i = 0; i < jobs; i++) {
+        pthread_mutex_init(&pool->ranges[i].lock, NULL);
+        pool->ranges[i].next = count * i / jobs;
+        pool->ranges[i].end = count * (i + 1) / jobs;
+    }
+}
+
+void runSeedsParallel(unsigned int firstSeed, unsigned int lastSeed, int jobs,
+                      SeedJob job, void *context, RunRecord *records) {
+    SeedPool pool = {.firstSeed = firstSeed, .job = job, .context = context, .records = records};
+    SeedWorker workers[MAX_JOBS];
+    pthread_t threads[MAX_JOBS];
+    int started[MAX_JOBS] = {0};
+    initPool(&pool, (size_t)(lastSeed - firstSeed) + 1, jobs);
+    for (int i = 0; i < jobs; i++) workers[i] = (SeedWorker){&pool, i};
+    for (int i = 1; i < jobs; i++) started[i] = pthread_create(&threads[i], NULL, runWorker, &workers[i]) == 0;
+    runWorker(&workers[0]);
+    for (int i = 1; i < jobs; i++) {
+        if (started[i]) pthread_join(threads[i], NULL);
+    }
+    for (int i = 0; i < jobs; i++) pthread_mutex_destroy(&pool.ranges[i].lock);
+}
+
+static int compareDoubles(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+/* Nearest-rank percentile of sorted values */
+static double percentile(const double *sorted, size_t count, int percent) {
+    size_t rank = (count * percent + 99) / 100;
+    return sorted[rank > 0 ? rank - 1 : 0];
+}
+
+static void printDistribution(const char *name, double *values, size_t count) {
+    double sum = 0.0;
+    for (size_t i = 0; i < count; i++) sum += values[i];
+    qsort(values, count, sizeof(double), compareDoubles);
+    printf(" %s_mean=%.2f %s_p50=%.2f %s_p95=%.2f %s_p99=%.2f", name, sum / count,
+           name, percentile(values, count, 50), name, percentile(values, count, 95),
+           name, percentile(values, count, 99));
+}
+
+/* Runs that failed to allocate are left out */
+void printRunSummary(const RunRecord *records, size_t count, double wallMs) {
+    double *values = malloc(2 * count * sizeof(double));
+    size_t runs = 0;
+    if (values == NULL) return;
+    for (size_t i = 0; i < count; i++) {
+        if (!records[i].ok) continue;
+        values[runs] = records[i].stats.steps;
+        values[count + runs++] = records[i].elapsedMs;
+    }
+    printf("summary runs=%zu", runs);
+    if (runs > 0) printDistribution("steps", values, runs);
+    if (runs > 0) printDistribution("time_ms", values + count, runs);
+    printf(" wall_ms=%.1f runs_per_s=%.1f\n", wallMs, wallMs > 0 ? runs * 1000.0 / wallMs : 0.0);
+    free(values);
+}
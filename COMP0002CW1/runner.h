@@ -0,0 +1,37 @@
+#ifndef RUNNER_H
+#define RUNNER_H
+
+#include <stddef.h>
+#include "team.h"
+
+#define MAX_JOBS 64
+
+/* One batch run; ok is 0 when the run could not be allocated */
+typedef struct {
+    unsigned int seed;
+    int ok;
+    int shape;
+    int width;
+    int height;
+    int ticks;
+    int markersLeft;
+    RunStats stats;
+    double elapsedMs;
+} RunRecord;
+
+/* Simulates one seed into record. Called concurrently from every worker */
+typedef void (*SeedJob)(void *context, unsigned int seed, RunRecord *record);
+
+/* Runs job for every seed in [firstSeed, lastSeed] on jobs threads.
+   Each worker starts on an equal slice of the range and, once its slice
+   is done, steals the back half of the fullest remaining one.
+   The calling thread is one of the workers, so every seed runs even if
+   no other thread can start. records[i] belongs to firstSeed + i */
+void runSeedsParallel(unsigned int firstSeed, unsigned int lastSeed, int jobs,
+                     SeedJob job, void *context, RunRecord *records);
+
+/* One line of mean and p50/p95/p99 steps and per-run time, plus runs per
+   second of wall-clock time */
+void printRunSummary(const RunRecord *records, size_t count, double wallMs);
+
+#endif
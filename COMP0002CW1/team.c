@@ -0,0 +1,220 @@
+#include <pthread.h>
+#include <stdlib.h>
+#include "pathfinding.h"
+#include "profile.h"
+#include "team.h"
+
+/* Per-tile claim states; a tile only ever moves forward through them */
+#define TILE_FREE 0
+#define TILE_CLAIMED 1
+#define TILE_VISITED 2
+
+typedef struct Team Team;
+
+/* path[next..] is the rest of the route to the claimed tile at its end */
+typedef struct {
+    Team *team;
+    Robot *robot;
+    RunStats *stats;
+    PathWorkspace workspace;
+    Path path;
+    int next;
+    int moved;
+} TeamMember;
+
+/* tiles is the shared claim map, written only with atomics. A tick ends
+   when waiting reaches active; robots with nothing left to do leave */
+struct Team {
+    Arena *arena;
+    Robot *robots;
+    TeamView *view;
+    unsigned char *tiles;
+    TeamMember members[MAX_TEAM_SIZE];
+    int count;
+    pthread_mutex_t lock;
+    pthread_cond_t tickDone;
+    int active;
+    int waiting;
+    int ticks;
+};
+
+static int tileState(Team *team, int tile) {
+    return __atomic_load_n(&team->tiles[tile], __ATOMIC_ACQUIRE);
+}
+
+static int claimTile(Team *team, int tile) {
+    unsigned char expected = TILE_FREE;
+    return __atomic_compare_exchange_n(&team->tiles[tile], &expected, TILE_CLAIMED, 0,
+                                       __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE);
+}
+
+/* Returns the state the tile had before */
+static int visitTile(Team *team, int tile) {
+    return __atomic_exchange_n(&team->tiles[tile], TILE_VISITED, __ATOMIC_ACQ_REL);
+}
+
+static int isFreeGoal(void *context, int x, int y) {
+    Team *team = context;
+    return tileState(team, y * team->arena->width + x) == TILE_FREE;
+}
+
+static int claimAdjacent(TeamMember *member) {
+    Arena *arena = member->team->arena;
+    for (int i = 0; i < 4; i++) {
+        int x = member->robot->x + DIRECTION_DX[i], y = member->robot->y + DIRECTION_DY[i];
+        if (isPassable(arena, x, y) && claimTile(member->team, y * arena->width + x)) {
+            member->path.x[0] = x;
+            member->path.y[0] = y;
+            member->path.length = 1;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/* Another robot may claim the found tile first; searching again sees its
+   claim. The robot's own tile is visited, so found paths are never empty */
+static int claimNearest(TeamMember *member) {
+    Path *path = &member->path;
+    for (;;) {
+        int found = findNearestPath(&member->workspace, member->robot->x, member->robot->y,
+                                    isFreeGoal, member->team, path);
+        member->stats->pathSearches++;
+        member->stats->nodesExpanded += path->expanded;
+        if (!found) return 0;
+        int end = path->y[path->length - 1] * member->team->arena->width + path->x[path->length - 1];
+        if (claimTile(member->team, end)) break;
+    }
+    member->stats->jumps++;
+    return 1;
+}
+
+/* A route is dropped once another robot has stepped on its target */
+static int hasRoute(TeamMember *member) {
+    Path *path = &member->path;
+    if (member->next >= path->length) return 0;
+    int end = path->y[path->length - 1] * member->team->arena->width + path->x[path->length - 1];
+    return tileState(member->team, end) != TILE_VISITED;
+}
+
+static int planRoute(TeamMember *member) {
+    member->next = 0;
+    return claimAdjacent(member) || claimNearest(member);
+}
+
+/* One move along the route; returns 0 when the robot has nothing left to do */
+static int stepMember(TeamMember *member) {
+    Robot *robot = member->robot;
+    Arena *arena = member->team->arena;
+    if (countMarkers(arena) == 0) return 0;
+    if (!hasRoute(member) && !planRoute(member)) return 0;
+    int x = member->path.x[member->next], y = member->path.y[member->next++];
+    member->stats->turns += turnTowards(robot, x, y);
+    forward(robot, arena);
+    member->stats->steps++;
+    if (visitTile(member->team, y * arena->width + x) == TILE_VISITED) member->stats->revisits++;
+    pickUpMarker(robot, arena);
+    member->moved = 1;
+    return 1;
+}
+
+/* Runs under the lock on the last robot to finish the tick */
+static void endTick(Team *team) {
+    for (int i = 0; i < team->count; i++) {
+        Robot *robot = team->members[i].robot;
+        if (!team->members[i].moved) continue;
+        team->members[i].moved = 0;
+        recordMovement(team->view->trail, robot->x, robot->y, robot->direction);
+        markTileDirty(team->view->dirty, robot->x, robot->y);
+    }
+    team->ticks++;
+    if (team->view->frame != NULL) team->view->frame(team->view->context, team->arena, team->robots, team->count);
+    team->waiting = 0;
+    pthread_cond_broadcast(&team->tickDone);
+}
+
+static void finishMove(Team *team) {
+    pthread_mutex_lock(&team->lock);
+    int tick = team->ticks;
+    if (++team->waiting == team->active) endTick(team);
+    while (team->ticks == tick) pthread_cond_wait(&team->tickDone, &team->lock);
+    pthread_mutex_unlock(&team->lock);
+}
+
+static void leaveTeam(Team *team) {
+    pthread_mutex_lock(&team->lock);
+    team->active--;
+    if (team->waiting > 0 && team->waiting == team->active) endTick(team);
+    pthread_mutex_unlock(&team->lock);
+}
+
+static void *runMember(void *argument) {
+    TeamMember *member = argument;
+    while (stepMember(member)) finishMove(member->team);
+    leaveTeam(member->team);
+    PROFILE_FLUSH();
+    return NULL;
+}
+
+static int initMember(Team *team, int index, RunStats *stats) {
+    TeamMember *member = &team->members[index];
+    Robot *robot = &team->robots[index];
+    member->team = team;
+    member->robot = robot;
+    member->stats = stats;
+    visitTile(team, robot->y * team->arena->width + robot->x);
+    pickUpMarker(robot, team->arena);
+    markTileDirty(team->view->dirty, robot->x, robot->y);
+    return initPath(&member->path, team->arena->width * team->arena->height) &&
+           initPathWorkspace(&member->workspace, team->arena);
+}
+
+/* Members are zeroed first, so freeTeam is safe after a partial init */
+static int initTeam(Team *team, Arena *arena, Robot *robots, int count, TeamView *view) {
+    team->arena = arena;
+    team->robots = robots;
+    team->view = view;
+    team->count = count;
+    team->active = count;
+    pthread_mutex_init(&team->lock, NULL);
+    pthread_cond_init(&team->tickDone, NULL);
+    team->tiles = calloc((size_t)arena->width * arena->height, 1);
+    return team->tiles != NULL;
+}
+
+static void freeTeam(Team *team) {
+    for (int i = 0; i < team->count; i++) {
+        freePath(&team->members[i].path);
+        freePathWorkspace(&team->members[i].workspace);
+    }
+    free(team->tiles);
+    pthread_cond_destroy(&team->tickDone);
+    pthread_mutex_destroy(&team->lock);
+}
+
+/* Robots whose thread failed to start leave, so the others never wait on them */
+static int startThreads(Team *team, pthread_t *threads) {
+    int started = 0;
+    while (started < team->count &&
+           pthread_create(&threads[started], NULL, runMember, &team->members[started]) == 0) {
+        started++;
+    }
+    for (int i = started; i < team->count; i++) leaveTeam(team);
+    return started;
+}
+
+int exploreAsTeam(Arena *arena, Robot *robots, int count, TeamView *view, TeamResult *result) {
+    Team team = {0};
+    pthread_t threads[MAX_TEAM_SIZE];
+    *result = (TeamResult){0};
+    int ok = initTeam(&team, arena, robots, count, view);
+    for (int i = 0; ok && i < count; i++) ok = initMember(&team, i, &result->robots[i]);
+    if (ok) {
+        int started = startThreads(&team, threads);
+        for (int i = 0; i < started; i++) pthread_join(threads[i], NULL);
+        ok = started == count;
+    }
+    result->ticks = team.ticks;
+    freeTeam(&team);
+    return ok;
+}
@@ -0,0 +1,42 @@
+#ifndef TEAM_H
+#define TEAM_H
+
+#include "arena.h"
+
+#define MAX_TEAM_SIZE 16
+
+/* Counters for one robot's run */
+typedef struct {
+    int steps;
+    int revisits;
+    int turns;
+    int jumps;
+    int pathSearches;
+    long nodesExpanded;
+} RunStats;
+
+/* Runs on one thread while every robot waits at the end of a tick, after
+   the team's moves have been recorded in the trail and dirty tiles */
+typedef void (*TeamFrame)(void *context, Arena *arena, Robot *robots, int count);
+
+/* Where a team run draws; frame may be NULL when nothing is drawn */
+typedef struct {
+    MovementTrail *trail;
+    DirtyTiles *dirty;
+    TeamFrame frame;
+    void *context;
+} TeamView;
+
+/* ticks counts rounds in which every active robot made one move */
+typedef struct {
+    int ticks;
+    RunStats robots[MAX_TEAM_SIZE];
+} TeamResult;
+
+/* Explores with count robots on one thread each until every marker is
+   picked up or no unclaimed tile is reachable. Robots claim targets with
+   an atomic compare-and-swap on a shared per-tile map and move in lockstep
+   ticks. Returns 0 if a buffer or thread could not be created */
+int exploreAsTeam(Arena *arena, Robot *robots, int count, TeamView *view, TeamResult *result);
+
+#endif
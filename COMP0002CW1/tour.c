@@ -0,0 +1,321 @@
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+#include "tour.h"
+
+#define UNREACHABLE -1
+
+/* Node 0 is the start, nodes 1.. are markers. nodeOfTile maps a tile to
+   its node plus one, or 0. route holds node indices, route[0] == 0 */
+typedef struct {
+    Arena *arena;
+    int nodes;
+    int *nodeTile;
+    int *nodeOfTile;
+    int *matrix;
+    int *distance;
+    int *queue;
+    int *route;
+    int stops;
+} TourPlanner;
+
+static int distanceBetween(TourPlanner *planner, int from, int to) {
+    return planner->matrix[from * planner->nodes + to];
+}
+
+/* Cost of leaving route position i; the open tour ends at no cost */
+static int legCost(TourPlanner *planner, int i) {
+    if (i + 1 >= planner->stops) return 0;
+    return distanceBetween(planner, planner->route[i], planner->route[i + 1]);
+}
+
+static int countNodes(Arena *arena) {
+    int count = 1;
+    size_t words = (size_t)arena->words_per_row * arena->height;
+    for (size_t i = 0; i < words; i++) {
+        for (uint64_t bits = arena->markers[i]; bits != 0; bits &= bits - 1) count++;
+    }
+    return count;
+}
+
+static void addNode(TourPlanner *planner, int tile) {
+    planner->nodeTile[planner->nodes] = tile;
+    planner->nodeOfTile[tile] = ++planner->nodes;
+}
+
+static void collectNodes(TourPlanner *planner, int startTile) {
+    Arena *arena = planner->arena;
+    planner->nodes = 0;
+    addNode(planner, startTile);
+    for (int y = 0; y < arena->height; y++) {
+        for (int i = 0; i < arena->words_per_row; i++) {
+            uint64_t bits = arena->markers[tileWord(arena, 0, y) + i];
+            for (; bits != 0; bits &= bits - 1) {
+                int tile = y * arena->width + i * 64 + lowestSetBit(bits);
+                if (tile != startTile) addNode(planner, tile);
+            }
+        }
+    }
+}
+
+static int allocatePlanner(TourPlanner *planner, Arena *arena) {
+    size_t tiles = (size_t)arena->width * arena->height;
+    size_t nodes = countNodes(arena);
+    planner->arena = arena;
+    planner->nodeOfTile = calloc(3 * tiles + nodes * (nodes + 2), sizeof(int));
+    if (planner->nodeOfTile == NULL) return 0;
+    planner->distance = planner->nodeOfTile + tiles;
+    planner->queue = planner->distance + tiles;
+    planner->nodeTile = planner->queue + tiles;
+    planner->route = planner->nodeTile + nodes;
+    planner->matrix = planner->route + nodes;
+    return 1;
+}
+
+static void visitTile(TourPlanner *planner, int tile, int distance, int *rear) {
+    if (!isPassable(planner->arena, tile % planner->arena->width, tile / planner->arena->width)) return;
+    if (planner->distance[tile] != UNREACHABLE) return;
+    planner->distance[tile] = distance;
+    planner->queue[(*rear)++] = tile;
+}
+
+static void visitNeighbours(TourPlanner *planner, int tile, int *rear) {
+    int width = planner->arena->width;
+    for (int i = 0; i < 4; i++) {
+        visitTile(planner, tile + DIRECTION_DY[i] * width + DIRECTION_DX[i],
+                  planner->distance[tile] + 1, rear);
+    }
+}
+
+/* One BFS fills a matrix row; it stops once every node has been reached */
+static void distancesFrom(TourPlanner *planner, int source) {
+    int width = planner->arena->width, front = 0, rear = 0, found = 0;
+    int *row = planner->matrix + source * planner->nodes;
+    for (int i = 0; i < planner->nodes; i++) row[i] = UNREACHABLE;
+    memset(planner->distance, 0xff, (size_t)width * planner->arena->height * sizeof(int));
+    visitTile(planner, planner->nodeTile[source], 0, &rear);
+    while (front < rear && found < planner->nodes) {
+        int tile = planner->queue[front++];
+        int node = planner->nodeOfTile[tile] - 1;
+        if (node >= 0 && row[node] == UNREACHABLE) found++;
+        if (node >= 0) row[node] = planner->distance[tile];
+        visitNeighbours(planner, tile, &rear);
+    }
+}
+
+/* Stops start with node 0 and keep only markers reachable from it */
+static void collectStops(TourPlanner *planner) {
+    planner->stops = 0;
+    for (int node = 0; node < planner->nodes; node++) {
+        if (distanceBetween(planner, 0, node) != UNREACHABLE) planner->route[planner->stops++] = node;
+    }
+}
+
+static int nearestUnrouted(TourPlanner *planner, int from, int first) {
+    int best = first;
+    for (int i = first + 1; i < planner->stops; i++) {
+        int node = planner->route[i];
+        if (distanceBetween(planner, from, node) < distanceBetween(planner, from, planner->route[best])) {
+            best = i;
+        }
+    }
+    return best;
+}
+
+static void nearestNeighbourRoute(TourPlanner *planner) {
+    for (int i = 1; i < planner->stops; i++) {
+        int best = nearestUnrouted(planner, planner->route[i - 1], i);
+        int node = planner->route[best];
+        planner->route[best] = planner->route[i];
+        planner->route[i] = node;
+    }
+}
+
+static void reverseRoute(TourPlanner *planner, int from, int to) {
+    for (; from < to; from++, to--) {
+        int node = planner->route[from];
+        planner->route[from] = planner->route[to];
+        planner->route[to] = node;
+    }
+}
+
+/* Reversing route[i..k] only changes the edges into i and out of k */
+static int twoOptGain(TourPlanner *planner, int i, int k) {
+    int *route = planner->route;
+    int before = legCost(planner, i - 1) + legCost(planner, k);
+    int after = distanceBetween(planner, route[i - 1], route[k]);
+    if (k + 1 < planner->stops) after += distanceBetween(planner, route[i], route[k + 1]);
+    return before - after;
+}
+
+static int twoOptPass(TourPlanner *planner) {
+    int improved = 0;
+    for (int i = 1; i < planner->stops - 1; i++) {
+        for (int k = i + 1; k < planner->stops; k++) {
+            if (twoOptGain(planner, i, k) > 0) {
+                reverseRoute(planner, i, k);
+                improved = 1;
+            }
+        }
+    }
+    return improved;
+}
+
+/* Removing route[i..end] saves its two edges and joins its neighbours */
+static int removalGain(TourPlanner *planner, int i, int end) {
+    int gain = legCost(planner, i - 1) + legCost(planner, end);
+    if (end + 1 < planner->stops) gain -= distanceBetween(planner, planner->route[i - 1], planner->route[end + 1]);
+    return gain;
+}
+
+static int insertionCost(TourPlanner *planner, int i, int end, int after) {
+    int *route = planner->route;
+    int cost = distanceBetween(planner, route[after], route[i]) - legCost(planner, after);
+    if (after + 1 < planner->stops) cost += distanceBetween(planner, route[end], route[after + 1]);
+    return cost;
+}
+
+/* Moves route[i..end] to follow position after, shifting the stops between */
+static void moveSegment(TourPlanner *planner, int i, int end, int after) {
+    int segment[3], length = end - i + 1, *route = planner->route;
+    memcpy(segment, route + i, length * sizeof(int));
+    if (after > end) {
+        memmove(route + i, route + end + 1, (after - end) * sizeof(int));
+        memcpy(route + after - length + 1, segment, length * sizeof(int));
+    } else {
+        memmove(route + after + 1 + length, route + after + 1, (i - after - 1) * sizeof(int));
+        memcpy(route + after + 1, segment, length * sizeof(int));
+    }
+}
+
+static int tryMoveSegment(TourPlanner *planner, int i, int end) {
+    int gain = removalGain(planner, i, end);
+    for (int after = 0; after < planner->stops; after++) {
+        if (after >= i - 1 && after <= end) continue;
+        if (insertionCost(planner, i, end, after) < gain) {
+            moveSegment(planner, i, end, after);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/* Or-opt: relocates runs of one to three stops */
+static int orOptPass(TourPlanner *planner) {
+    int improved = 0;
+    for (int length = 1; length <= 3; length++) {
+        for (int i = 1; i + length <= planner->stops; i++) {
+            improved |= tryMoveSegment(planner, i, i + length - 1);
+        }
+    }
+    return improved;
+}
+
+static void heuristicRoute(TourPlanner *planner) {
+    nearestNeighbourRoute(planner);
+    while (twoOptPass(planner) | orOptPass(planner)) {
+    }
+}
+
+/* cost[mask * markers + last]: cheapest walk from the start through the
+   markers in mask, ending at last */
+static void extendSubset(TourPlanner *planner, const int *stops, int *cost, int *parent,
+                         int mask, int last) {
+    int markers = planner->stops - 1;
+    for (int next = 0; next < markers; next++) {
+        if (mask & (1 << next)) continue;
+        int state = (mask | 1 << next) * markers + next;
+        int total = cost[mask * markers + last] + distanceBetween(planner, stops[last], stops[next]);
+        if (total < cost[state]) {
+            cost[state] = total;
+            parent[state] = last;
+        }
+    }
+}
+
+static int cheapestLast(const int *cost, int markers) {
+    int full = (1 << markers) - 1, best = 0;
+    for (int last = 1; last < markers; last++) {
+        if (cost[full * markers + last] < cost[full * markers + best]) best = last;
+    }
+    return best;
+}
+
+static void rebuildRoute(TourPlanner *planner, const int *stops, const int *cost, const int *parent) {
+    int markers = planner->stops - 1, mask = (1 << markers) - 1;
+    int last = cheapestLast(cost, markers);
+    for (int position = markers; position >= 1; position--) {
+        int previous = parent[mask * markers + last];
+        planner->route[position] = stops[last];
+        mask ^= 1 << last;
+        last = previous;
+    }
+}
+
+static void solveSubsets(TourPlanner *planner, const int *stops, int *cost, int *parent) {
+    int markers = planner->stops - 1;
+    for (size_t state = 0; state < ((size_t)markers << markers); state++) cost[state] = INT_MAX;
+    for (int i = 0; i < markers; i++) cost[(1 << i) * markers + i] = distanceBetween(planner, 0, stops[i]);
+    for (int mask = 1; mask < 1 << markers; mask++) {
+        for (int last = 0; last < markers; last++) {
+            if (cost[mask * markers + last] == INT_MAX) continue;
+            extendSubset(planner, stops, cost, parent, mask, last);
+        }
+    }
+}
+
+/* Held-Karp dynamic programme over marker subsets */
+static int exactRoute(TourPlanner *planner) {
+    int markers = planner->stops - 1;
+    size_t states = (size_t)markers << markers;
+    int *cost = malloc((2 * states + markers) * sizeof(int));
+    if (cost == NULL) return 0;
+    int *parent = cost + states, *stops = parent + states;
+    memcpy(stops, planner->route + 1, markers * sizeof(int));
+    solveSubsets(planner, stops, cost, parent);
+    rebuildRoute(planner, stops, cost, parent);
+    free(cost);
+    return 1;
+}
+
+static int orderStops(TourPlanner *planner) {
+    if (planner->stops <= 2) return 1;
+    if (planner->stops - 1 <= TOUR_EXACT_LIMIT) return exactRoute(planner);
+    heuristicRoute(planner);
+    return 1;
+}
+
+static int exportTour(TourPlanner *planner, MarkerTour *tour) {
+    int width = planner->arena->width;
+    tour->count = planner->stops - 1;
+    tour->x = malloc(2 * ((size_t)tour->count + 1) * sizeof(int));
+    if (tour->x == NULL) return 0;
+    tour->y = tour->x + tour->count + 1;
+    for (int i = 0; i < tour->count; i++) {
+        tour->x[i] = planner->nodeTile[planner->route[i + 1]] % width;
+        tour->y[i] = planner->nodeTile[planner->route[i + 1]] / width;
+        tour->length += legCost(planner, i);
+    }
+    return 1;
+}
+
+int planMarkerTour(Arena *arena, int startX, int startY, MarkerTour *tour) {
+    TourPlanner planner;
+    *tour = (MarkerTour){0};
+    if (!allocatePlanner(&planner, arena)) return 0;
+    collectNodes(&planner, startY * arena->width + startX);
+    for (int node = 0; node < planner.nodes; node++) {
+        distancesFrom(&planner, node);
+    }
+    collectStops(&planner);
+    int planned = orderStops(&planner) && exportTour(&planner, tour);
+    free(planner.nodeOfTile);
+    return planned;
+}
+
+void freeMarkerTour(MarkerTour *tour) {
+    free(tour->x);
+    tour->x = NULL;
+    tour->y = NULL;
+    tour->count = 0;
+}
@@ -0,0 +1,24 @@
+#ifndef TOUR_H
+#define TOUR_H
+
+#include "arena.h"
+
+/* Largest marker count solved exactly; larger tours use nearest neighbour
+   improved by 2-opt and Or-opt */
+#define TOUR_EXACT_LIMIT 12
+
+/* Reachable markers in visiting order; length is the planned step count
+   from the start through the last marker */
+typedef struct {
+    int *x;
+    int *y;
+    int count;
+    int length;
+} MarkerTour;
+
+/* Plans an open tour over every marker reachable from the start, using the
+   full map. Returns 0 if out of memory */
+int planMarkerTour(Arena *arena, int startX, int startY, MarkerTour *tour);
+void freeMarkerTour(MarkerTour *tour);
+
+#endif
@@ -0,0 +1,282 @@
+#include <stdlib.h>
+#include <string.h>
+#include "layer.h"
+#include "profile.h"
+#include "render.h"
+#include "trace.h"
+
+/* Replay state; pending is set once a single robot's forward step has
+   been applied and its frame is still open */
+typedef struct {
+    const Trace *trace;
+    Arena *arena;
+    MovementTrail trail;
+    DirtyTiles dirty;
+    StaticLayer layer;
+    Robot robots[MAX_TEAM_SIZE];
+    Robot *robot;
+    FrameGate gate;
+    int frame;
+    int fromFrame;
+    int pending;
+} TraceReplay;
+
+extern const int TILE_SIZE;
+
+/* The marker on a start tile goes to the first robot that starts there */
+static int startsOnMarker(const Arena *arena, const Robot *robots, int index) {
+    for (int i = 0; i < index; i++) {
+        if (robots[i].x == robots[index].x && robots[i].y == robots[index].y) return 0;
+    }
+    return hasMarker(arena, robots[index].x, robots[index].y);
+}
+
+int initTrace(Trace *trace, const Arena *arena, const Robot *robots, int count) {
+    size_t words = (size_t)arena->words_per_row * arena->height;
+    *trace = (Trace){.count = count};
+    trace->markers = malloc(words * sizeof(uint64_t));
+    if (trace->markers == NULL) return 0;
+    memcpy(trace->markers, arena->markers, words * sizeof(uint64_t));
+    for (int i = 0; i < count; i++) {
+        trace->starts[i] = robots[i];
+        trace->last[i] = robots[i];
+        trace->last[i].markers_held += startsOnMarker(arena, robots, i);
+    }
+    return 1;
+}
+
+void freeTrace(Trace *trace) {
+    free(trace->events);
+    free(trace->markers);
+    trace->events = NULL;
+    trace->markers = NULL;
+}
+
+static int reserveEvent(Trace *trace) {
+    if (trace->length < trace->capacity) return 1;
+    size_t capacity = trace->capacity ? trace->capacity * 2 : 256;
+    unsigned char *grown = realloc(trace->events, capacity);
+    if (grown == NULL) return 0;
+    trace->events = grown;
+    trace->capacity = capacity;
+    return 1;
+}
+
+/* Adds as much of count as fits to the last event when it has the same
+   opcode, and returns what is left */
+static int extendLastEvent(Trace *trace, int op, int count) {
+    unsigned char *last = trace->length > 0 ? &trace->events[trace->length - 1] : NULL;
+    if (last == NULL || op == TRACE_ROBOT || *last >> 5 != op) return count;
+    int room = TRACE_MAX_REPEAT - 1 - (*last & 31);
+    int taken = count < room ? count : room;
+    *last += taken;
+    return count - taken;
+}
+
+/* Extends the last event when it can, so a straight run of n steps costs
+   one byte per 32 */
+static void appendEvent(Trace *trace, int op, int count) {
+    count = extendLastEvent(trace, op, count);
+    while (count > 0) {
+        int taken = count < TRACE_MAX_REPEAT ? count : TRACE_MAX_REPEAT;
+        if (!reserveEvent(trace)) {
+            trace->failed = 1;
+            return;
+        }
+        trace->events[trace->length++] = (unsigned char)(op << 5 | (taken - 1));
+        count -= taken;
+    }
+}
+
+static int hasChanged(const Robot *last, const Robot *robot) {
+    return last->x != robot->x || last->y != robot->y || last->direction != robot->direction ||
+           last->markers_held != robot->markers_held;
+}
+
+/* Turns go the shorter way round, as turnTowards takes them */
+static void recordRobot(Trace *trace, int index, const Robot *robot) {
+    Robot *last = &trace->last[index];
+    if (!hasChanged(last, robot)) return;
+    if (trace->count > 1 && trace->current != index + 1) {
+        appendEvent(trace, TRACE_ROBOT, index + 1);
+        trace->current = index + 1;
+    }
+    int clockwise = (directionIndex(robot->direction) - directionIndex(last->direction) + 4) % 4;
+    if (clockwise == 3) appendEvent(trace, TRACE_LEFT, 1);
+    else if (clockwise > 0) appendEvent(trace, TRACE_RIGHT, clockwise);
+    if (last->x != robot->x || last->y != robot->y) appendEvent(trace, TRACE_FORWARD, 1);
+    int held = robot->markers_held - last->markers_held;
+    if (held > 0) appendEvent(trace, TRACE_PICKUP, held);
+    if (held < 0) appendEvent(trace, TRACE_DROP, -held);
+    *last = *robot;
+}
+
+void recordTraceFrame(Trace *trace, const Robot *robots, int count) {
+    int moved = count > 1 || trace->last[0].x != robots[0].x || trace->last[0].y != robots[0].y;
+    for (int i = 0; i < count; i++) recordRobot(trace, i, &robots[i]);
+    if (count > 1) appendEvent(trace, TRACE_TICK, 1);
+    trace->frames += moved;
+}
+
+static int writeStarts(FILE *file, const Trace *trace) {
+    int ok = 1;
+    for (int i = 0; i < trace->count; i++) {
+        TraceStart start = {(uint16_t)trace->starts[i].x, (uint16_t)trace->starts[i].y,
+                            trace->starts[i].direction, {0}};
+        ok &= fwrite(&start, sizeof start, 1, file) == 1;
+    }
+    return ok;
+}
+
+int writeTrace(FILE *file, const Trace *trace, const Arena *arena, const ArenaInfo *info) {
+    static const unsigned char padding[8] = {0};
+    TraceFileHeader header = {TRACE_MAGIC, (uint32_t)trace->count, (uint32_t)trace->frames,
+                              (uint32_t)trace->length};
+    size_t pad = (8 - trace->length % 8) % 8;
+    Arena start = *arena;
+    start.markers = trace->markers;
+    if (trace->failed || trace->length > UINT32_MAX) return 0;
+    return writeArena(file, &start, info) && fwrite(&header, sizeof header, 1, file) == 1 &&
+           writeStarts(file, trace) && fwrite(trace->events, 1, trace->length, file) == trace->length &&
+           fwrite(padding, 1, pad, file) == pad;
+}
+
+static int isValidStart(const Arena *arena, const TraceStart *start) {
+    return start->x < arena->width && start->y < arena->height && isPassable(arena, start->x, start->y) &&
+           strchr("NESW", start->direction) != NULL && start->direction != '\0';
+}
+
+static int readStarts(FILE *file, Trace *trace, const Arena *arena) {
+    for (int i = 0; i < trace->count; i++) {
+        TraceStart start;
+        if (fread(&start, sizeof start, 1, file) != 1 || !isValidStart(arena, &start)) return 0;
+        trace->starts[i] = (Robot){start.x, start.y, start.direction, 0};
+    }
+    return 1;
+}
+
+static int readEvents(FILE *file, Trace *trace, size_t length) {
+    size_t padded = (length + 7) & ~(size_t)7;
+    trace->events = malloc(padded > 0 ? padded : 1);
+    trace->length = length;
+    trace->capacity = padded;
+    return trace->events != NULL && fread(trace->events, 1, padded, file) == padded;
+}
+
+int readTrace(FILE *file, Trace *trace, Arena *arena, ArenaInfo *info) {
+    TraceFileHeader header;
+    *trace = (Trace){0};
+    if (!readArena(file, arena, info)) return 0;
+    if (fread(&header, sizeof header, 1, file) == 1 && memcmp(header.magic, TRACE_MAGIC, 4) == 0 &&
+        header.robots > 0 && header.robots <= MAX_TEAM_SIZE) {
+        trace->count = (int)header.robots;
+        trace->frames = (int)header.frames;
+        if (readStarts(file, trace, arena) && readEvents(file, trace, header.length)) return 1;
+    }
+    freeTrace(trace);
+    freeArena(arena);
+    return 0;
+}
+
+/* Everything drawapp needs to show the arena as it is now */
+static void drawReplayArena(TraceReplay *replay) {
+    Arena *arena = replay->arena;
+    PROFILE_TIMER(start);
+    setWindowSize(arena->width * TILE_SIZE, arena->height * TILE_SIZE);
+    buildStaticLayer(&replay->layer, arena);
+    drawBackground(arena, &replay->layer);
+    foreground();
+    PROFILE_ELAPSED(PROFILE_RENDER, start);
+}
+
+static void drawReplayFrame(TraceReplay *replay) {
+    drawRobotFrame(&replay->dirty, replay->arena, &replay->trail, replay->robots,
+                   replay->trace->count, replay->gate.settings->delay);
+}
+
+/* The frame a replay starts from is drawn whatever the render mode */
+static void endFrame(TraceReplay *replay) {
+    replay->pending = 0;
+    if (++replay->frame < replay->fromFrame) return;
+    int first = replay->frame == replay->fromFrame;
+    if (!passesFrameGate(&replay->gate, replay->arena) && !first) return;
+    if (first) drawReplayArena(replay);
+    drawReplayFrame(replay);
+}
+
+static void replayForward(TraceReplay *replay) {
+    Robot *robot = replay->robot;
+    forward(robot, replay->arena);
+    recordMovement(&replay->trail, robot->x, robot->y, robot->direction);
+    replay->pending = 1;
+}
+
+/* Marks tiles dirty where the live run did, so the commands match it */
+static void applyStep(TraceReplay *replay, int op) {
+    Robot *robot = replay->robot;
+    if (replay->trace->count == 1 && replay->pending && op <= TRACE_RIGHT) endFrame(replay);
+    if (op == TRACE_FORWARD) {
+        replayForward(replay);
+    } else if (op == TRACE_LEFT) {
+        left(robot);
+    } else if (op == TRACE_RIGHT) {
+        right(robot);
+    } else if (op == TRACE_PICKUP) {
+        pickUpMarker(robot, replay->arena);
+    } else {
+        dropMarker(robot, replay->arena);
+    }
+    if (op == TRACE_FORWARD || op >= TRACE_PICKUP) markTileDirty(&replay->dirty, robot->x, robot->y);
+}
+
+static int applyEvent(TraceReplay *replay, unsigned char event) {
+    int op = event >> 5, count = (event & 31) + 1;
+    if (op == TRACE_ROBOT) {
+        if (count > replay->trace->count) return 0;
+        replay->robot = &replay->robots[count - 1];
+    } else if (op == TRACE_TICK) {
+        while (count-- > 0) endFrame(replay);
+    } else if (op <= TRACE_DROP) {
+        while (count-- > 0) applyStep(replay, op);
+    } else {
+        return 0;
+    }
+    return 1;
+}
+
+/* A team marks every start tile dirty; a single robot only one it picks up at */
+static void pickUpAtStarts(TraceReplay *replay) {
+    int count = replay->trace->count;
+    for (int i = 0; i < count; i++) {
+        Robot *robot = &replay->robots[i];
+        if (count == 1 && !atMarker(robot, replay->arena)) continue;
+        pickUpMarker(robot, replay->arena);
+        markTileDirty(&replay->dirty, robot->x, robot->y);
+    }
+}
+
+static int playEvents(TraceReplay *replay) {
+    if (replay->fromFrame == 0) drawReplayArena(replay);
+    pickUpAtStarts(replay);
+    for (size_t i = 0; i < replay->trace->length; i++) {
+        if (!applyEvent(replay, replay->trace->events[i])) return 0;
+    }
+    if (replay->pending) endFrame(replay);
+    if (replay->gate.skipped && replay->frame > replay->fromFrame) drawReplayFrame(replay);
+    return 1;
+}
+
+int replayTrace(const Trace *trace, Arena *arena, int fromFrame, const RenderSettings *render) {
+    TraceReplay replay = {trace, arena};
+    int ok = initMovementTrail(&replay.trail, arena->width, arena->height) &&
+             initDirtyTiles(&replay.dirty, arena->width, arena->height);
+    replay.fromFrame = fromFrame < trace->frames ? fromFrame : trace->frames;
+    initFrameGate(&replay.gate, render, arena);
+    replay.robot = &replay.robots[0];
+    memcpy(replay.robots, trace->starts, sizeof replay.robots);
+    if (ok) ok = playEvents(&replay);
+    freeStaticLayer(&replay.layer);
+    freeMovementTrail(&replay.trail);
+    freeDirtyTiles(&replay.dirty);
+    return ok;
+}
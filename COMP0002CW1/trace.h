@@ -0,0 +1,76 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdio.h>
+#include "arenafile.h"
+#include "render.h"
+#include "team.h"
+
+#define TRACE_MAGIC "TRC1"
+
+/* Event bytes hold an opcode in the top three bits and a repeat count of
+   1-32, stored minus one, in the bottom five. TRACE_ROBOT's count is
+   instead the index, plus one, of the robot the events after it move */
+#define TRACE_FORWARD 0
+#define TRACE_LEFT 1
+#define TRACE_RIGHT 2
+#define TRACE_PICKUP 3
+#define TRACE_DROP 4
+#define TRACE_ROBOT 5
+#define TRACE_TICK 6
+#define TRACE_MAX_REPEAT 32
+
+/* A trace record follows the run's starting arena record: this header,
+   one start pose per robot, then length event bytes padded to 8 bytes */
+typedef struct {
+    char magic[4];
+    uint32_t robots;
+    uint32_t frames;
+    uint32_t length;
+} TraceFileHeader;
+
+typedef struct {
+    uint16_t x;
+    uint16_t y;
+    char direction;
+    char reserved[3];
+} TraceStart;
+
+/* One run's moves. A single robot's frame is its turns, one forward step
+   and what it picks up or drops there; a team's frame ends at TRACE_TICK.
+   Robots pick up any marker they start on before the first frame.
+   markers is the marker bitplane as the run started, and last the robot
+   poses as of the last recorded frame */
+typedef struct {
+    unsigned char *events;
+    size_t length;
+    size_t capacity;
+    int frames;
+    int count;
+    int current;
+    int failed;
+    uint64_t *markers;
+    Robot starts[MAX_TEAM_SIZE];
+    Robot last[MAX_TEAM_SIZE];
+} Trace;
+
+/* Call once the robots are placed, before the run moves anything */
+int initTrace(Trace *trace, const Arena *arena, const Robot *robots, int count);
+void freeTrace(Trace *trace);
+/* Appends the change in every robot since the last frame */
+void recordTraceFrame(Trace *trace, const Robot *robots, int count);
+
+/* Writes the starting arena, then the trace. arena is the run's own; its
+   passable plane never changes, and the markers come from the trace */
+int writeTrace(FILE *file, const Trace *trace, const Arena *arena, const ArenaInfo *info);
+/* Reads the next run; arena is its starting arena. Returns 0 at end of
+   file or on a bad record, leaving nothing to free */
+int readTrace(FILE *file, Trace *trace, Arena *arena, ArenaInfo *info);
+
+/* Prints drawapp commands for the run, changing arena as it goes. Frames
+   before fromFrame are applied without drawing, then the whole picture is
+   drawn once and the rest play as render selects, ending on the final
+   state */
+int replayTrace(const Trace *trace, Arena *arena, int fromFrame, const RenderSettings *render);
+
+#endif